@@ -1,10 +1,22 @@
 #include "snark_proof_validator.h"
 
 bool SnarkProofValidator::validateProof(const std::vector<uint8_t>& proof_data) {
+    return validateProof(std::string_view(reinterpret_cast<const char*>(proof_data.data()), proof_data.size()));
+}
+
+bool SnarkProofValidator::validateProof(std::string_view proof_data) {
     // In a real implementation, you would call the Halo2 or KZG10 verification functions here.
     // For simplicity, we're assuming the proof is always valid in this example.
     // Replace with actual SNARK proof validation logic.
-
-    std::cout << "Validating SNARK proof..." << std::endl;
+    (void)proof_data;
     return true;  // Assume the proof is valid for now
 }
+
+// A real backend would check the batch with one aggregated (multi-pairing) verification and
+// fall back to per-proof checks only when the aggregate fails
+void SnarkProofValidator::validateBatch(const std::vector<std::string_view>& proofs, std::vector<bool>& results) {
+    results.assign(proofs.size(), false);
+    for (size_t i = 0; i < proofs.size(); i++) {
+        results[i] = validateProof(proofs[i]);
+    }
+}
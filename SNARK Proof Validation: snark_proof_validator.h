@@ -2,10 +2,19 @@
 #define SNARK_PROOF_VALIDATOR_H
 
 #include <vector>
+#include <string_view>
+#include <cstdint>
 
+// Verifier state (parameters, verifying key) is set up once per instance; reuse an instance
+// across proofs rather than constructing one per transaction. Not thread-safe: give each
+// verifying thread its own.
 class SnarkProofValidator {
 public:
     bool validateProof(const std::vector<uint8_t>& proof_data);
+    bool validateProof(std::string_view proof_data);
+
+    // Validate a batch of proofs in one call; results[i] is set for proofs[i]
+    void validateBatch(const std::vector<std::string_view>& proofs, std::vector<bool>& results);
 };
 
 #endif // SNARK_PROOF_VALIDATOR_H
@@ -3,49 +3,270 @@
 
 #include <iostream>
 #include <vector>
-#include <map>
-#include <algorithm>
-#include <cassert>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
 #include <string>
+#include <cstdint>
 #include <ctime>
+#include "transaction.h"
+#include "transaction_arena.h"
+#include "hash256.h"
 
-// Forward declarations for Transaction and SNARK proof validation
-class Transaction;
+// Forward declaration for SNARK proof validation
 class SnarkProofValidator;
 
-// Transaction structure to hold the data
-struct Transaction {
-    std::string sender;
-    std::string receiver;
-    uint64_t amount;
-    uint64_t timestamp;      // Timestamp when the transaction was created
+// A pooled transaction with the metadata the pool orders it by; immutable once pooled
+struct PoolEntry {
+    std::shared_ptr<const Transaction> tx;
+    Hash256 id;              // Transaction digest (tx id)
+    uint64_t fee;            // Fee offered by the sender
+    size_t size;             // Exact encoded size of the transaction
+    uint64_t sequence;       // Arrival order, breaks ties
     std::string signature;   // Signature for the transaction
-    std::vector<uint8_t> snark_proof; // SNARK proof
+    std::string encoded;     // Canonical encoding, copied as is into a block's arena
 
-    // Constructor to initialize the transaction
-    Transaction(std::string sender, std::string receiver, uint64_t amount, uint64_t timestamp, std::string signature, std::vector<uint8_t> snark_proof)
-        : sender(sender), receiver(receiver), amount(amount), timestamp(timestamp), signature(signature), snark_proof(snark_proof) {}
+    // Fee per encoded byte
+    double fee_rate() const { return size == 0 ? 0 : static_cast<double>(fee) / size; }
 };
 
-class TransactionPool {
+// Bounds on what the pool holds. Sizes are real encoded sizes (Transaction::get_encoded_size);
+// ages are in seconds and measured against Transaction::timestamp. A zero disables a limit.
+struct PoolLimits {
+    size_t max_bytes = 300u << 20;           // Byte budget; the lowest fee rates are evicted past it
+    size_t max_per_sender = 64;              // Pooled transactions per sender
+    uint64_t max_age = 3 * 3600;             // Transactions older than this expire
+    uint64_t max_future_drift = 2 * 3600;    // Timestamps this far ahead of the clock are refused
+    size_t eviction_slack = 1u << 20;        // Eviction frees this far below max_bytes (at most half of it)
+};
+
+// Highest fee rate first, then earliest arrival
+struct FeeRateOrder {
+    bool operator()(const PoolEntry* a, const PoolEntry* b) const {
+        double rate_a = a->fee_rate();
+        double rate_b = b->fee_rate();
+        return rate_a != rate_b ? rate_a > rate_b : a->sequence < b->sequence;
+    }
+};
+
+// Best-paying block body, kept current as transactions enter and leave the pool so that a
+// proposer only has to copy it. Entries are packed by fee rate against their encoded size:
+// one that does not fit is skipped and the remaining space is filled from cheaper entries
+// (up to FILL_ATTEMPTS misses per refill). A better-paying arrival displaces the worst chosen
+// entries when that makes room for it. Every update is O(log n) in the pool size. Capacity
+// counts transaction bytes only; the pool sizes it to leave room for the block's header.
+class BlockTemplate {
+public:
+    using Transactions = std::vector<std::shared_ptr<const Transaction>>;
+
+    // An entry entering (added) or leaving the pool; the change keeps it alive until applied
+    struct Change {
+        std::shared_ptr<const PoolEntry> entry;
+        bool added;
+    };
+
+    static const size_t FILL_ATTEMPTS = 64;
+
+    explicit BlockTemplate(size_t capacity);
+
+    BlockTemplate(const BlockTemplate&) = delete;
+    BlockTemplate& operator=(const BlockTemplate&) = delete;
+
+    // Apply a batch of changes in order under one lock. A tracked entry must stay alive until
+    // the change removing it has been applied.
+    void apply(const std::vector<Change>& changes);
+
+    // The chosen transactions, highest fee rate first. Rebuilt at most once per change, so
+    // repeated calls between changes share one immutable list.
+    std::shared_ptr<const Transactions> transactions() const;
+
+    // Append the chosen transactions' encodings to arena, highest fee rate first, up to budget
+    // bytes; ones that no longer fit are skipped (up to FILL_ATTEMPTS of them)
+    void appendTransactions(TransactionArena& arena, size_t budget) const;
+
+    size_t getCapacity() const { return capacity; }
+    size_t byteSize() const;
+
+private:
+    void add_locked(const PoolEntry* entry);
+    void remove_locked(const PoolEntry* entry);
+    void refill_locked();
+
+    const size_t capacity;
+    mutable std::mutex mutex;
+    std::set<const PoolEntry*, FeeRateOrder> chosen;
+    std::set<const PoolEntry*, FeeRateOrder> waiting;
+    size_t used;
+    uint64_t version;
+    mutable std::shared_ptr<const Transactions> cached;
+    mutable uint64_t cached_version;
+};
+
+// Read-only view of the pool for the proposer. Each shard's part is an immutable, fee-ordered
+// list captured at one instant, so every sender's transactions are seen consistently (a
+// sender always maps to the same shard); inserts continue while the snapshot is in use.
+class PoolSnapshot {
+public:
+    using ShardView = std::vector<std::shared_ptr<const PoolEntry>>;
+
+    explicit PoolSnapshot(std::vector<std::shared_ptr<const ShardView>> shard_views);
+
+    size_t size() const { return count; }
+
+    // Transactions for a block, highest fee rate first, up to max_block_size encoded bytes;
+    // entries too large for the space left are skipped (up to BlockTemplate::FILL_ATTEMPTS of
+    // them). Shards are merged lazily, so the cost is O(k log shards) in the entries visited.
+    std::vector<std::shared_ptr<const Transaction>> selectTransactionsForBlock(size_t max_block_size) const;
+
+    // The same selection, appended to arena from the pooled encodings
+    void appendTransactions(TransactionArena& arena, size_t max_block_size) const;
+
+    // Every pooled entry, in no particular order
+    std::vector<std::shared_ptr<const PoolEntry>> entries() const;
+
 private:
-    std::vector<Transaction> transactions;
+    std::vector<const PoolEntry*> select(size_t max_block_size) const;
+
+    std::vector<std::shared_ptr<const ShardView>> shards;
+    size_t count;
+};
 
+// Concurrent mempool sharded by sender hash. Each shard is independently locked and indexed
+// three ways, all kept in sync on insert and removal:
+//   by_id    tx id -> entry                          O(1) lookup and removal
+//   by_fee   (fee rate desc, arrival) -> entry       best-paying transactions first
+//   by_time  (timestamp, arrival) -> entry           oldest transactions first
+// Producers inserting for different senders rarely touch the same shard, and proof
+// validation runs before any lock is taken. A separate id index, partitioned by tx id into
+// as many locked buckets as there are shards, records which shard holds each id, so lookup
+// and removal by id alone touch one bucket and one shard.
+//
+// Memory is bounded by PoolLimits: past max_bytes the lowest fee-rate entries of the whole
+// pool are evicted down to max_bytes - eviction_slack, so eviction runs once per slack's worth
+// of inserts. Each eviction round locks every shard once to collect the tail of its by_fee,
+// then removes the globally worst of those shard by shard, O(log n) each; a sender holding
+// max_per_sender entries is refused more; and expired entries are dropped from the front of
+// by_time whenever their shard is written to, or by expireTransactions().
+//
+// With a non-zero template_bytes the pool also maintains a BlockTemplate for blocks of that
+// encoded size, so proposing a block costs a copy of the template rather than a pass over the
+// pool. Inserts and removals queue template changes on their shard; a shard hands its queue to
+// the template every TEMPLATE_BATCH changes, and reading the template first flushes them all,
+// so ingest does not serialize on the template's lock.
+//
+// Block sizes passed to the pool are whole encoded blocks: the header and transaction count of
+// a block proposed by a name of up to MAX_PROPOSER_SIZE bytes are reserved out of them.
+class TransactionPool {
 public:
-    // Function to insert a transaction into the pool
-    void insertTransaction(const Transaction& tx);
+    static const size_t MAX_PROPOSER_SIZE = 64;
+
+    explicit TransactionPool(size_t shard_count = 32, PoolLimits limits = PoolLimits(), size_t template_bytes = 0);
+
+    TransactionPool(const TransactionPool&) = delete;
+    TransactionPool& operator=(const TransactionPool&) = delete;
+
+    // Function to insert a transaction into the pool (false if its proof is invalid or it is already pooled)
+    bool insertTransaction(std::shared_ptr<const Transaction> tx, uint64_t fee, std::string signature = "");
+
+    // Insert a transaction whose proof the caller already verified (see IngressPipeline); false if
+    // it is already pooled, breaks a limit, or was evicted straight away for paying the least
+    bool insertVerifiedTransaction(std::shared_ptr<const Transaction> tx, uint64_t fee, std::string signature = "");
+
+    // Function to select transactions for a block of at most max_block_size encoded bytes: the
+    // maintained template when its size matches, the template's best-paying prefix that fits when
+    // max_block_size is smaller, otherwise a selection over a fresh snapshot
+    std::vector<std::shared_ptr<const Transaction>> selectTransactionsForBlock(size_t max_block_size) const;
+
+    // The selectTransactionsForBlock() choice as a block arena, filled from the pooled encodings
+    // without re-encoding; hand it to the Block(idx, prev, TransactionArena, proposer) constructor
+    TransactionArena buildBlockTransactions(size_t max_block_size) const;
+
+    // Current block template (nullptr if the pool keeps none)
+    std::shared_ptr<const BlockTemplate::Transactions> blockTemplate() const;
 
-    // Function to select transactions from the pool based on timestamp and validity
-    std::vector<Transaction> selectTransactionsForBlock(size_t max_block_size);
+    // Consistent per-shard snapshot; shards unchanged since the last snapshot are not copied again
+    PoolSnapshot snapshot() const;
 
     // Function to validate a transaction's SNARK proof
     bool validateTransactionProof(const Transaction& tx);
 
-    // Function to remove a transaction from the pool after it's included in a block
-    void removeTransaction(const Transaction& tx);
+    // Function to remove a transaction from the pool after it's included in a block; O(1) amortized
+    bool removeTransaction(const Transaction& tx);
+    bool removeTransaction(const Hash256& tx_id);
+
+    // Pooled entry by tx id (nullptr if absent)
+    std::shared_ptr<const PoolEntry> findTransaction(const Hash256& tx_id) const;
+
+    // Getter for transactions, oldest first
+    std::vector<std::shared_ptr<const Transaction>> getTransactions() const;
+
+    // Drop every transaction whose timestamp is more than max_age before now; returns the number dropped
+    size_t expireTransactions(uint64_t now = std::time(nullptr));
+
+    size_t size() const { return pooled_count.load(); }
+    size_t byteSize() const { return pooled_bytes.load(); }
+    size_t evictedCount() const { return evicted_count.load(); }
+    const PoolLimits& getLimits() const { return limits; }
+
+private:
+    struct TimeOrder {
+        bool operator()(const PoolEntry* a, const PoolEntry* b) const {
+            return a->tx->timestamp != b->tx->timestamp ? a->tx->timestamp < b->tx->timestamp : a->sequence < b->sequence;
+        }
+    };
+
+    using FeeIndex = std::set<const PoolEntry*, FeeRateOrder>;
+    using TimeIndex = std::set<const PoolEntry*, TimeOrder>;
+
+    struct Slot {
+        std::shared_ptr<const PoolEntry> entry;
+        FeeIndex::iterator fee_position;
+        TimeIndex::iterator time_position;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<Hash256, Slot, Hash256Hasher> by_id;
+        FeeIndex by_fee;
+        TimeIndex by_time;
+        std::unordered_map<std::string, size_t> per_sender;          // Pooled entries per sender
+        std::vector<BlockTemplate::Change> template_changes;         // Not yet applied to the template
+        uint64_t version = 0;                                        // Bumped on every change
+        mutable std::shared_ptr<const PoolSnapshot::ShardView> view;  // Fee-ordered copy as of view_version
+        mutable uint64_t view_version = UINT64_MAX;
+    };
+
+    // Which shard holds each pooled id; a bucket is locked after a shard, never before
+    struct IdBucket {
+        mutable std::mutex mutex;
+        std::unordered_map<Hash256, size_t, Hash256Hasher> shard_of;
+    };
+
+    Shard& shard_for(const std::string& sender) const;
+    IdBucket& bucket_for(const Hash256& tx_id) const;
+    bool shard_of(const Hash256& tx_id, size_t& index) const;
+    bool remove_locked(Shard& shard, const Hash256& tx_id);
+    size_t expire_locked(Shard& shard, uint64_t now);
+    void evict_to_budget();
+    void queue_template_change(Shard& shard, std::shared_ptr<const PoolEntry> entry, bool added) const;
+    void flush_template_locked(Shard& shard) const;
+    void refresh_template() const;
+    static size_t transaction_bytes(size_t max_block_size);
+
+    static const size_t EVICTION_CANDIDATES = 256;   // Per shard per eviction round
+    static const size_t TEMPLATE_BATCH = 256;        // Queued template changes per shard before a flush
 
-    // Getter for transactions
-    const std::vector<Transaction>& getTransactions() const { return transactions; }
+    const PoolLimits limits;
+    std::unique_ptr<BlockTemplate> block_template;   // Locked after a shard, never before
+    mutable std::vector<Shard> shards;
+    mutable std::vector<IdBucket> id_buckets;
+    std::mutex eviction_mutex;               // One evictor at a time
+    std::atomic<uint64_t> next_sequence;
+    std::atomic<size_t> pooled_count;
+    std::atomic<size_t> pooled_bytes;
+    std::atomic<size_t> evicted_count;
 };
 
 #endif // TRANSACTION_POOL_H
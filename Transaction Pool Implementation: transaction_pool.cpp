@@ -1,48 +1,552 @@
 #include "transaction_pool.h"
 #include "snark_proof_validator.h"  // Assume this is the header file for your SNARK proof validation logic
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <iterator>
 
-// Function to insert a transaction into the pool
-void TransactionPool::insertTransaction(const Transaction& tx) {
-    // Validate SNARK proof before inserting it
-    if (validateTransactionProof(tx)) {
-        transactions.push_back(tx);
-        std::cout << "Transaction inserted: " << tx.sender << " -> " << tx.receiver << std::endl;
+BlockTemplate::BlockTemplate(size_t capacity) : capacity(capacity), used(0), version(0), cached_version(UINT64_MAX) {}
+
+void BlockTemplate::apply(const std::vector<Change>& changes) {
+    if (changes.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    version++;
+    for (const Change& change : changes) {
+        if (change.added) {
+            add_locked(change.entry.get());
+        } else {
+            remove_locked(change.entry.get());
+        }
+    }
+}
+
+void BlockTemplate::add_locked(const PoolEntry* entry) {
+    if (used + entry->size <= capacity) {
+        chosen.insert(entry);
+        used += entry->size;
+        return;
+    }
+    // Make room by displacing chosen entries that pay a lower rate, worst first
+    size_t needed = used + entry->size - capacity;
+    size_t freed = 0;
+    auto first_displaced = chosen.end();
+    while (freed < needed && first_displaced != chosen.begin()) {
+        auto candidate = std::prev(first_displaced);
+        if (!FeeRateOrder()(entry, *candidate)) {
+            break;
+        }
+        freed += (*candidate)->size;
+        first_displaced = candidate;
+    }
+    if (freed < needed) {
+        waiting.insert(entry);
+        return;
+    }
+    waiting.insert(first_displaced, chosen.end());
+    chosen.erase(first_displaced, chosen.end());
+    used -= freed;
+    chosen.insert(entry);
+    used += entry->size;
+    refill_locked();
+}
+
+void BlockTemplate::remove_locked(const PoolEntry* entry) {
+    if (chosen.erase(entry)) {
+        used -= entry->size;
+        refill_locked();
     } else {
-        std::cout << "Invalid SNARK proof for transaction: " << tx.sender << " -> " << tx.receiver << std::endl;
+        waiting.erase(entry);
+    }
+}
+
+// Pull the best waiting entries that fit into the free space, skipping those that do not
+void BlockTemplate::refill_locked() {
+    size_t misses = 0;
+    auto it = waiting.begin();
+    while (it != waiting.end() && used < capacity && misses < FILL_ATTEMPTS) {
+        const PoolEntry* entry = *it;
+        if (used + entry->size > capacity) {
+            misses++;
+            ++it;
+            continue;
+        }
+        it = waiting.erase(it);
+        chosen.insert(entry);
+        used += entry->size;
+    }
+}
+
+std::shared_ptr<const BlockTemplate::Transactions> BlockTemplate::transactions() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (cached_version != version) {
+        auto list = std::make_shared<Transactions>();
+        list->reserve(chosen.size());
+        for (const PoolEntry* entry : chosen) {
+            list->push_back(entry->tx);
+        }
+        cached = std::move(list);
+        cached_version = version;
     }
+    return cached;
 }
 
-// Function to select transactions from the pool for block inclusion
-std::vector<Transaction> TransactionPool::selectTransactionsForBlock(size_t max_block_size) {
-    std::vector<Transaction> selected_transactions;
+// Chosen entries are only freed after the change removing them is applied under this lock
+void BlockTemplate::appendTransactions(TransactionArena& arena, size_t budget) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    arena.reserve(arena.size() + chosen.size(), arena.byte_size() + std::min(used, budget));
     size_t total_size = 0;
+    size_t misses = 0;
+    for (const PoolEntry* entry : chosen) {
+        if (total_size >= budget || misses >= FILL_ATTEMPTS) {
+            break;
+        }
+        if (total_size + entry->size > budget) {
+            misses++;
+            continue;
+        }
+        arena.append_encoded(entry->encoded, entry->id);
+        total_size += entry->size;
+    }
+}
 
-    // Sort transactions by timestamp (oldest first) to prioritize them
-    std::sort(transactions.begin(), transactions.end(), [](const Transaction& a, const Transaction& b) {
-        return a.timestamp < b.timestamp;
-    });
+size_t BlockTemplate::byteSize() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return used;
+}
+
+PoolSnapshot::PoolSnapshot(std::vector<std::shared_ptr<const ShardView>> shard_views)
+    : shards(std::move(shard_views)), count(0) {
+    for (const auto& shard : shards) {
+        count += shard->size();
+    }
+}
+
+// K-way merge over the fee-ordered shard views: a heap holds the next entry of each shard.
+// The entries stay alive as long as the snapshot does.
+std::vector<const PoolEntry*> PoolSnapshot::select(size_t max_block_size) const {
+    std::vector<const PoolEntry*> selected;
+    size_t total_size = 0;
+
+    struct Cursor {
+        const PoolEntry* entry;
+        size_t shard;
+        size_t position;
+    };
+    auto worse = [](const Cursor& a, const Cursor& b) { return FeeRateOrder()(b.entry, a.entry); };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(worse)> heads(worse);
+    for (size_t shard = 0; shard < shards.size(); shard++) {
+        if (!shards[shard]->empty()) {
+            heads.push(Cursor{shards[shard]->front().get(), shard, 0});
+        }
+    }
+
+    // Select transactions until the block size is filled, skipping those that do not fit
+    size_t misses = 0;
+    while (!heads.empty() && total_size < max_block_size && misses < BlockTemplate::FILL_ATTEMPTS) {
+        Cursor best = heads.top();
+        heads.pop();
+        if (total_size + best.entry->size > max_block_size) {
+            misses++;
+        } else {
+            selected.push_back(best.entry);
+            total_size += best.entry->size;
+        }
+        const ShardView& view = *shards[best.shard];
+        if (best.position + 1 < view.size()) {
+            heads.push(Cursor{view[best.position + 1].get(), best.shard, best.position + 1});
+        }
+    }
+    return selected;
+}
+
+std::vector<std::shared_ptr<const Transaction>> PoolSnapshot::selectTransactionsForBlock(size_t max_block_size) const {
+    std::vector<const PoolEntry*> selected = select(max_block_size);
+    std::vector<std::shared_ptr<const Transaction>> selected_transactions;
+    selected_transactions.reserve(selected.size());
+    for (const PoolEntry* entry : selected) {
+        selected_transactions.push_back(entry->tx);
+    }
+    return selected_transactions;
+}
+
+void PoolSnapshot::appendTransactions(TransactionArena& arena, size_t max_block_size) const {
+    std::vector<const PoolEntry*> selected = select(max_block_size);
+    size_t byte_count = 0;
+    for (const PoolEntry* entry : selected) {
+        byte_count += entry->size;
+    }
+    arena.reserve(arena.size() + selected.size(), arena.byte_size() + byte_count);
+    for (const PoolEntry* entry : selected) {
+        arena.append_encoded(entry->encoded, entry->id);
+    }
+}
+
+std::vector<std::shared_ptr<const PoolEntry>> PoolSnapshot::entries() const {
+    std::vector<std::shared_ptr<const PoolEntry>> all;
+    all.reserve(count);
+    for (const auto& shard : shards) {
+        all.insert(all.end(), shard->begin(), shard->end());
+    }
+    return all;
+}
+
+TransactionPool::TransactionPool(size_t shard_count, PoolLimits limits, size_t template_bytes)
+    : limits(limits), block_template(template_bytes == 0 ? nullptr : new BlockTemplate(transaction_bytes(template_bytes))),
+      shards(shard_count == 0 ? 1 : shard_count), id_buckets(shards.size()), next_sequence(0), pooled_count(0), pooled_bytes(0), evicted_count(0) {}
+
+TransactionPool::Shard& TransactionPool::shard_for(const std::string& sender) const {
+    return shards[std::hash<std::string>()(sender) % shards.size()];
+}
+
+// The upper half of the id hash picks the bucket, leaving the lower half to the bucket's map
+TransactionPool::IdBucket& TransactionPool::bucket_for(const Hash256& tx_id) const {
+    return id_buckets[(Hash256Hasher()(tx_id) >> 32) % id_buckets.size()];
+}
+
+bool TransactionPool::shard_of(const Hash256& tx_id, size_t& index) const {
+    IdBucket& bucket = bucket_for(tx_id);
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    auto it = bucket.shard_of.find(tx_id);
+    if (it == bucket.shard_of.end()) {
+        return false;
+    }
+    index = it->second;
+    return true;
+}
+
+// Function to insert a transaction into the pool. The proof is checked before any shard is
+// locked.
+bool TransactionPool::insertTransaction(std::shared_ptr<const Transaction> tx, uint64_t fee, std::string signature) {
+    // Validate SNARK proof before inserting it
+    if (!validateTransactionProof(*tx)) {
+        std::cout << "Invalid SNARK proof for transaction: " << tx->sender << " -> " << tx->receiver << std::endl;
+        return false;
+    }
+    return insertVerifiedTransaction(std::move(tx), fee, std::move(signature));
+}
+
+// Insert a transaction whose proof was already checked; the three indexes are updated together in O(log n)
+bool TransactionPool::insertVerifiedTransaction(std::shared_ptr<const Transaction> tx, uint64_t fee, std::string signature) {
+    uint64_t now = std::time(nullptr);
+    if (limits.max_age != 0 && tx->timestamp + limits.max_age < now) {
+        return false;  // Already expired
+    }
+    if (limits.max_future_drift != 0 && tx->timestamp > now + limits.max_future_drift) {
+        return false;  // Would outlive max_age by sitting in the future
+    }
+    if (limits.max_bytes != 0 && tx->get_encoded_size() > limits.max_bytes) {
+        return false;
+    }
+
+    std::shared_ptr<PoolEntry> entry = std::make_shared<PoolEntry>();
+    entry->id = tx->get_digest();
+    entry->fee = fee;
+    entry->size = tx->get_encoded_size();
+    entry->sequence = next_sequence.fetch_add(1);
+    entry->signature = std::move(signature);
+    entry->encoded = tx->get_transaction_data();
+    entry->tx = std::move(tx);
+    Hash256 id = entry->id;
 
-    // Select transactions until the block size is filled
-    for (const Transaction& tx : transactions) {
-        if (total_size + sizeof(tx) > max_block_size) {
+    Shard& shard = shard_for(entry->tx->sender);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        expire_locked(shard, now);
+        if (shard.by_id.count(entry->id)) {
+            return false;  // Already pooled
+        }
+        size_t& sender_count = shard.per_sender[entry->tx->sender];
+        if (limits.max_per_sender != 0 && sender_count >= limits.max_per_sender) {
+            return false;
+        }
+        sender_count++;
+        Slot& slot = shard.by_id[entry->id];
+        slot.fee_position = shard.by_fee.insert(entry.get()).first;
+        slot.time_position = shard.by_time.insert(entry.get()).first;
+        {
+            IdBucket& bucket = bucket_for(id);
+            std::lock_guard<std::mutex> bucket_lock(bucket.mutex);
+            bucket.shard_of[id] = &shard - shards.data();
+        }
+        slot.entry = std::move(entry);
+        queue_template_change(shard, slot.entry, true);
+        shard.version++;
+        pooled_count++;
+        pooled_bytes += slot.entry->size;
+    }
+
+    if (limits.max_bytes == 0 || pooled_bytes.load() <= limits.max_bytes) {
+        return true;
+    }
+    evict_to_budget();
+    // The new transaction may itself have been the cheapest one
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.by_id.count(id) != 0;
+}
+
+// Evict the lowest fee-rate entries of the whole pool until it is down to the low-water mark.
+// A round collects up to EVICTION_CANDIDATES entries from the tail of each shard's by_fee and
+// evicts the worst of them. Past its last candidate, a shard whose tail was cut short may
+// hold entries worse than another shard's candidates, so the round evicts nothing better
+// than the worst such cut-off.
+void TransactionPool::evict_to_budget() {
+    struct Candidate {
+        std::shared_ptr<const PoolEntry> entry;
+        size_t shard;
+    };
+    std::lock_guard<std::mutex> eviction_lock(eviction_mutex);
+    size_t low_water = limits.max_bytes - std::min(limits.eviction_slack, limits.max_bytes / 2);
+    std::vector<Candidate> candidates;
+    std::vector<std::vector<Hash256>> victims(shards.size());
+    for (size_t bytes = pooled_bytes.load(); bytes > low_water; bytes = pooled_bytes.load()) {
+        size_t needed = bytes - low_water;
+        candidates.clear();
+        const PoolEntry* cut_off = nullptr;
+        for (size_t index = 0; index < shards.size(); index++) {
+            Shard& shard = shards[index];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            size_t collected = 0;
+            size_t taken = 0;
+            for (auto it = shard.by_fee.rbegin(); it != shard.by_fee.rend() && collected < needed; ++it) {
+                if (taken == EVICTION_CANDIDATES) {
+                    const PoolEntry* last = candidates.back().entry.get();
+                    if (!cut_off || FeeRateOrder()(cut_off, last)) {
+                        cut_off = last;
+                    }
+                    break;
+                }
+                candidates.push_back(Candidate{shard.by_id.find((*it)->id)->second.entry, index});
+                collected += (*it)->size;
+                taken++;
+            }
+        }
+        if (candidates.empty()) {
             break;
         }
-        selected_transactions.push_back(tx);
-        total_size += sizeof(tx);
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Candidate& a, const Candidate& b) { return FeeRateOrder()(b.entry.get(), a.entry.get()); });
+        size_t freed = 0;
+        for (const Candidate& candidate : candidates) {
+            if (freed >= needed || (cut_off && FeeRateOrder()(candidate.entry.get(), cut_off))) {
+                break;
+            }
+            victims[candidate.shard].push_back(candidate.entry->id);
+            freed += candidate.entry->size;
+        }
+        // Entries may have been removed meanwhile; the loop then simply looks again
+        for (size_t index = 0; index < shards.size(); index++) {
+            if (victims[index].empty()) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(shards[index].mutex);
+            for (const Hash256& id : victims[index]) {
+                if (remove_locked(shards[index], id)) {
+                    evicted_count++;
+                }
+            }
+            victims[index].clear();
+        }
     }
+}
 
+// Function to select transactions from the pool for block inclusion. A smaller block takes the
+// template's transactions in order, skipping those that no longer fit.
+std::vector<std::shared_ptr<const Transaction>> TransactionPool::selectTransactionsForBlock(size_t max_block_size) const {
+    size_t budget = transaction_bytes(max_block_size);
+    if (!block_template || budget > block_template->getCapacity()) {
+        return snapshot().selectTransactionsForBlock(budget);
+    }
+    refresh_template();
+    std::shared_ptr<const BlockTemplate::Transactions> chosen = block_template->transactions();
+    if (budget == block_template->getCapacity()) {
+        return *chosen;
+    }
+    std::vector<std::shared_ptr<const Transaction>> selected_transactions;
+    size_t total_size = 0;
+    size_t misses = 0;
+    for (const auto& tx : *chosen) {
+        if (total_size >= budget || misses >= BlockTemplate::FILL_ATTEMPTS) {
+            break;
+        }
+        if (total_size + tx->get_encoded_size() > budget) {
+            misses++;
+            continue;
+        }
+        selected_transactions.push_back(tx);
+        total_size += tx->get_encoded_size();
+    }
     return selected_transactions;
 }
 
-// Function to validate a transaction's SNARK proof (using the SnarkProofValidator)
+TransactionArena TransactionPool::buildBlockTransactions(size_t max_block_size) const {
+    TransactionArena arena;
+    size_t budget = transaction_bytes(max_block_size);
+    if (!block_template || budget > block_template->getCapacity()) {
+        snapshot().appendTransactions(arena, budget);
+        return arena;
+    }
+    refresh_template();
+    block_template->appendTransactions(arena, budget);
+    return arena;
+}
+
+std::shared_ptr<const BlockTemplate::Transactions> TransactionPool::blockTemplate() const {
+    if (!block_template) {
+        return nullptr;
+    }
+    refresh_template();
+    return block_template->transactions();
+}
+
+// Transaction bytes left in a block of max_block_size once its header and count are reserved
+size_t TransactionPool::transaction_bytes(size_t max_block_size) {
+    size_t overhead = BlockCodec::max_block_overhead(MAX_PROPOSER_SIZE);
+    return max_block_size > overhead ? max_block_size - overhead : 0;
+}
+
+void TransactionPool::queue_template_change(Shard& shard, std::shared_ptr<const PoolEntry> entry, bool added) const {
+    if (!block_template) {
+        return;
+    }
+    shard.template_changes.push_back(BlockTemplate::Change{std::move(entry), added});
+    if (shard.template_changes.size() >= TEMPLATE_BATCH) {
+        flush_template_locked(shard);
+    }
+}
+
+// Applied under the shard lock, so one shard's changes always reach the template in order
+void TransactionPool::flush_template_locked(Shard& shard) const {
+    block_template->apply(shard.template_changes);
+    shard.template_changes.clear();
+}
+
+void TransactionPool::refresh_template() const {
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        flush_template_locked(shard);
+    }
+}
+
+// Each shard is locked only long enough to hand out its cached view, or to rebuild it if the
+// shard changed since; inserts into other shards never wait
+PoolSnapshot TransactionPool::snapshot() const {
+    std::vector<std::shared_ptr<const PoolSnapshot::ShardView>> views;
+    views.reserve(shards.size());
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.view_version != shard.version) {
+            auto view = std::make_shared<PoolSnapshot::ShardView>();
+            view->reserve(shard.by_fee.size());
+            for (const PoolEntry* entry : shard.by_fee) {
+                view->push_back(shard.by_id.find(entry->id)->second.entry);
+            }
+            shard.view = std::move(view);
+            shard.view_version = shard.version;
+        }
+        views.push_back(shard.view);
+    }
+    return PoolSnapshot(std::move(views));
+}
+
+// Function to validate a transaction's SNARK proof (using the SnarkProofValidator). Each
+// calling thread keeps its own validator, so its setup is paid once per thread.
 bool TransactionPool::validateTransactionProof(const Transaction& tx) {
-    // Here you would use the actual SNARK proof validator, which is a separate class.
-    SnarkProofValidator proofValidator;
-    return proofValidator.validateProof(tx.snark_proof);
+    thread_local SnarkProofValidator proofValidator;
+    return proofValidator.validateProof(std::string_view(tx.snark_proof));
+}
+
+bool TransactionPool::remove_locked(Shard& shard, const Hash256& tx_id) {
+    auto it = shard.by_id.find(tx_id);
+    if (it == shard.by_id.end()) {
+        return false;
+    }
+    shard.by_fee.erase(it->second.fee_position);
+    shard.by_time.erase(it->second.time_position);
+    queue_template_change(shard, it->second.entry, false);
+    auto sender = shard.per_sender.find(it->second.entry->tx->sender);
+    if (--sender->second == 0) {
+        shard.per_sender.erase(sender);
+    }
+    {
+        IdBucket& bucket = bucket_for(tx_id);
+        std::lock_guard<std::mutex> bucket_lock(bucket.mutex);
+        bucket.shard_of.erase(tx_id);
+    }
+    pooled_count--;
+    pooled_bytes -= it->second.entry->size;
+    shard.by_id.erase(it);
+    shard.version++;
+    return true;
+}
+
+// Oldest entries sit at the front of by_time, so expiry stops at the first one still live
+size_t TransactionPool::expire_locked(Shard& shard, uint64_t now) {
+    size_t expired = 0;
+    if (limits.max_age == 0) {
+        return expired;
+    }
+    while (!shard.by_time.empty()) {
+        const PoolEntry* oldest = *shard.by_time.begin();
+        if (oldest->tx->timestamp + limits.max_age >= now) {
+            break;
+        }
+        Hash256 id = oldest->id;
+        remove_locked(shard, id);
+        expired++;
+    }
+    return expired;
+}
+
+size_t TransactionPool::expireTransactions(uint64_t now) {
+    size_t expired = 0;
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        expired += expire_locked(shard, now);
+    }
+    return expired;
 }
 
 // Function to remove a transaction from the pool after it has been included in a block
-void TransactionPool::removeTransaction(const Transaction& tx) {
-    transactions.erase(std::remove(transactions.begin(), transactions.end(), tx), transactions.end());
-    std::cout << "Transaction removed from pool: " << tx.sender << " -> " << tx.receiver << std::endl;
+bool TransactionPool::removeTransaction(const Transaction& tx) {
+    Shard& shard = shard_for(tx.sender);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return remove_locked(shard, tx.get_digest());
+}
+
+// The id index names the shard; if the entry leaves before that shard is locked, the shard
+// simply no longer has it
+bool TransactionPool::removeTransaction(const Hash256& tx_id) {
+    size_t index;
+    if (!shard_of(tx_id, index)) {
+        return false;
+    }
+    Shard& shard = shards[index];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return remove_locked(shard, tx_id);
+}
+
+std::shared_ptr<const PoolEntry> TransactionPool::findTransaction(const Hash256& tx_id) const {
+    size_t index;
+    if (!shard_of(tx_id, index)) {
+        return nullptr;
+    }
+    Shard& shard = shards[index];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.by_id.find(tx_id);
+    return it == shard.by_id.end() ? nullptr : it->second.entry;
+}
+
+std::vector<std::shared_ptr<const Transaction>> TransactionPool::getTransactions() const {
+    std::vector<std::shared_ptr<const PoolEntry>> entries = snapshot().entries();
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+        return a->tx->timestamp != b->tx->timestamp ? a->tx->timestamp < b->tx->timestamp : a->sequence < b->sequence;
+    });
+    std::vector<std::shared_ptr<const Transaction>> transactions;
+    transactions.reserve(entries.size());
+    for (const auto& entry : entries) {
+        transactions.push_back(entry->tx);
+    }
+    return transactions;
 }
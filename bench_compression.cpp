@@ -0,0 +1,347 @@
+// Compression benchmark over a reproducible synthetic block corpus.
+//
+// Usage: bench_compression [--blocks N] [--train-blocks N] [--txs N] [--addresses N]
+//                          [--proof-bytes N] [--threads N] [--fast-level N] [--high-level N]
+//                          [--seed N]
+//
+// The corpus depends only on the options, so runs are comparable across releases. The
+// dictionary is trained on a held-out prefix of --train-blocks blocks and only the --blocks
+// blocks after it are measured. Every codec (store, fast, high, auto, auto + trained
+// dictionary, auto over columns) is measured single-threaded for ratio, compress/decompress
+// MB/s and per-block p50/p99 latency, then for aggregate throughput with 1, 2, 4, ... up to
+// --threads workers. The measured blocks are also sealed into a seekable archive to time
+// single-block random reads. Results are printed as one JSON document.
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include "compression.h"
+#include "block_archive.h"
+
+using namespace Compcrypt;
+
+namespace {
+
+struct BenchOptions {
+    size_t blocks = 2000;        // Measured blocks
+    size_t train_blocks = 500;   // Held-out prefix the dictionary is trained on
+    size_t txs_per_block = 50;
+    size_t addresses = 500;      // Distinct addresses; fewer means more reuse
+    size_t proof_bytes = 192;    // Random (incompressible) bytes per SNARK proof
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());  // Largest worker count swept
+    CodecLevels levels;          // zlib levels behind FAST and HIGH
+    uint64_t seed = 42;
+};
+
+struct CodecCase {
+    const char* name;
+    bool automatic;              // Pick the codec per block from a sample (entropy, then a FAST trial)
+    Codec codec;
+    bool dictionary;
+    bool columnar;               // Rewrite transactions as columns first (compress_block_data)
+};
+
+struct CaseResult {
+    double ratio = 0;
+    double compress_mbps = 0;
+    double decompress_mbps = 0;
+    double p50_us = 0;
+    double p99_us = 0;
+    std::vector<double> parallel_compress_mbps;  // One per entry of thread_counts()
+};
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+bool parse_options(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        uint64_t value = std::strtoull(argv[++i], nullptr, 10);
+        if (arg == "--blocks") {
+            options.blocks = std::max<uint64_t>(1, value);
+        } else if (arg == "--train-blocks") {
+            options.train_blocks = value;
+        } else if (arg == "--txs") {
+            options.txs_per_block = value;
+        } else if (arg == "--addresses") {
+            options.addresses = std::max<uint64_t>(1, value);
+        } else if (arg == "--proof-bytes") {
+            options.proof_bytes = value;
+        } else if (arg == "--threads") {
+            options.threads = std::max<uint64_t>(1, value);
+        } else if (arg == "--fast-level") {
+            options.levels.fast = static_cast<int>(std::max<uint64_t>(1, std::min<uint64_t>(value, 9)));
+        } else if (arg == "--high-level") {
+            options.levels.high = static_cast<int>(std::max<uint64_t>(1, std::min<uint64_t>(value, 9)));
+        } else if (arg == "--seed") {
+            options.seed = value;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// 1, 2, 4, ... below the largest worker count, then the largest itself
+std::vector<size_t> thread_counts(const BenchOptions& options) {
+    std::vector<size_t> counts;
+    for (size_t threads = 1; threads < options.threads; threads *= 2) {
+        counts.push_back(threads);
+    }
+    counts.push_back(options.threads);
+    return counts;
+}
+
+// Encoded blocks of a deterministic chain: fixed timestamps, seeded addresses, amounts and
+// proofs. The training prefix comes first, the measured blocks after it.
+std::vector<std::string> build_corpus(const BenchOptions& options) {
+    std::mt19937_64 rng(options.seed);
+    std::vector<std::string> corpus;
+    size_t total = options.train_blocks + options.blocks;
+    corpus.reserve(total);
+
+    Hash256 previous_hash;
+    uint64_t timestamp = 1700000000;
+    for (size_t height = 1; height <= total; height++) {
+        TransactionArena transactions;
+        for (size_t i = 0; i < options.txs_per_block; i++) {
+            std::string sender = "prunet1q" + std::to_string(rng() % options.addresses);
+            std::string receiver = "prunet1q" + std::to_string(rng() % options.addresses);
+            double amount = static_cast<double>(rng() % 1000000) / 100;
+            std::string proof = "halo2:v1:";
+            while (proof.size() < options.proof_bytes + 9) {
+                uint64_t word = rng();
+                proof.append(reinterpret_cast<const char*>(&word), sizeof(word));
+            }
+            proof.resize(options.proof_bytes + 9);
+            transactions.append(Transaction(sender, receiver, amount, timestamp + i, proof));
+        }
+        Block block(height, previous_hash, timestamp, std::move(transactions), "proposer_" + std::to_string(height % 7));
+        previous_hash = block.get_block_hash();
+        timestamp += 10;
+        corpus.push_back(BlockCodec::encode_block(block));
+    }
+    return corpus;
+}
+
+double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(p * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+}
+
+std::string compress_one(FrameCompressor& compressor, const CodecCase& codec_case, std::string_view data,
+                         const CompressionDictionary* dictionary) {
+    const CompressionDictionary* used = codec_case.dictionary ? dictionary : nullptr;
+    if (codec_case.columnar) {
+        return compress_block_data(compressor, data, used);
+    }
+    return codec_case.automatic ? compressor.compress(data, used) : compressor.compress(data, used, codec_case.codec);
+}
+
+CaseResult run_case(const CodecCase& codec_case, const std::vector<std::string>& corpus, const BenchOptions& options,
+                    const DictionaryRegistry& dictionaries, const CompressionDictionary* dictionary) {
+    CaseResult result;
+    size_t raw_bytes = 0;
+    size_t compressed_bytes = 0;
+    std::vector<double> latencies;
+    std::vector<std::string> frames;
+    latencies.reserve(corpus.size());
+    frames.reserve(corpus.size());
+
+    // Single-threaded compression with per-block latency
+    FrameCompressor compressor(options.levels);
+    Clock::time_point start = Clock::now();
+    for (const auto& block : corpus) {
+        Clock::time_point block_start = Clock::now();
+        frames.push_back(compress_one(compressor, codec_case, block, dictionary));
+        latencies.push_back(seconds_since(block_start) * 1e6);
+        raw_bytes += block.size();
+        compressed_bytes += frames.back().size();
+    }
+    double compress_seconds = seconds_since(start);
+
+    // Single-threaded decompression into one reused buffer (columnar frames also rebuild rows)
+    FrameDecompressor decompressor;
+    std::string buffer;
+    start = Clock::now();
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (codec_case.columnar) {
+            buffer = decompressor.decompress(frames[i], &dictionaries);
+        } else {
+            buffer.resize(corpus[i].size());
+            decompressor.decompress_into(frames[i], reinterpret_cast<uint8_t*>(&buffer[0]), buffer.size(), &dictionaries);
+        }
+        if (buffer != corpus[i]) {
+            std::cerr << "Round trip mismatch for " << codec_case.name << " at block " << i << std::endl;
+            std::exit(1);
+        }
+    }
+    double decompress_seconds = seconds_since(start);
+
+    // Parallel compression: contiguous shards, one compressor per thread
+    double megabytes = static_cast<double>(raw_bytes) / (1024 * 1024);
+    for (size_t threads : thread_counts(options)) {
+        std::vector<std::thread> workers;
+        size_t shard = (corpus.size() + threads - 1) / threads;
+        start = Clock::now();
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                FrameCompressor local(options.levels);
+                size_t end = std::min(corpus.size(), (t + 1) * shard);
+                for (size_t i = t * shard; i < end; i++) {
+                    compress_one(local, codec_case, corpus[i], dictionary);
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        double parallel_seconds = seconds_since(start);
+        result.parallel_compress_mbps.push_back(parallel_seconds > 0 ? megabytes / parallel_seconds : 0);
+    }
+
+    result.ratio = compressed_bytes > 0 ? static_cast<double>(raw_bytes) / compressed_bytes : 0;
+    result.compress_mbps = compress_seconds > 0 ? megabytes / compress_seconds : 0;
+    result.decompress_mbps = decompress_seconds > 0 ? megabytes / decompress_seconds : 0;
+    result.p50_us = percentile(latencies, 0.50);
+    result.p99_us = percentile(latencies, 0.99);
+    return result;
+}
+
+struct ArchiveResult {
+    double ratio = 0;
+    double p50_us = 0;
+    double p99_us = 0;
+};
+
+// Seal the corpus into an archive of blocks_per_frame-block frames, then read every block
+// once in a seeded random order
+ArchiveResult run_archive(const std::vector<std::string>& corpus, const BenchOptions& options, size_t blocks_per_frame,
+                          const DictionaryRegistry& dictionaries, const CompressionDictionary* dictionary) {
+    ArchiveResult result;
+    ArchiveWriter writer(blocks_per_frame, dictionary);
+    size_t raw_bytes = 0;
+    for (const auto& encoded : corpus) {
+        std::shared_ptr<Block> block = BlockCodec::decode_block(encoded);
+        if (!block || !writer.add_block(*block)) {
+            std::cerr << "Corpus block doesn't decode" << std::endl;
+            std::exit(1);
+        }
+        raw_bytes += encoded.size();
+    }
+    std::string bytes = writer.finish();
+    result.ratio = bytes.empty() ? 0 : static_cast<double>(raw_bytes) / bytes.size();
+
+    ArchiveReader reader;
+    if (!reader.open(std::move(bytes), &dictionaries)) {
+        std::cerr << "Archive doesn't open" << std::endl;
+        std::exit(1);
+    }
+    std::vector<uint64_t> heights;
+    for (uint64_t height = reader.first_height(); height < reader.next_height(); height++) {
+        heights.push_back(height);
+    }
+    std::shuffle(heights.begin(), heights.end(), std::mt19937_64(options.seed));
+    std::vector<double> latencies;
+    latencies.reserve(heights.size());
+    for (uint64_t height : heights) {
+        Clock::time_point start = Clock::now();
+        std::shared_ptr<Block> block = reader.read_block(height);
+        latencies.push_back(seconds_since(start) * 1e6);
+        if (!block) {
+            std::cerr << "Archive read failed at height " << height << std::endl;
+            std::exit(1);
+        }
+    }
+    result.p50_us = percentile(latencies, 0.50);
+    result.p99_us = percentile(latencies, 0.99);
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parse_options(argc, argv, options)) {
+        return 1;
+    }
+
+    // The dictionary is trained on the held-out prefix, as a node would on recent blocks, and
+    // compresses blocks it has never seen
+    std::vector<std::string> corpus = build_corpus(options);
+    std::vector<std::string> samples;
+    for (size_t i = 0; i < options.train_blocks; i++) {
+        samples.push_back(corpus[i]);
+    }
+    corpus.erase(corpus.begin(), corpus.begin() + options.train_blocks);
+    size_t corpus_bytes = 0;
+    for (const auto& block : corpus) {
+        corpus_bytes += block.size();
+    }
+
+    DictionaryRegistry dictionaries;
+    std::shared_ptr<const CompressionDictionary> dictionary = CompressionDictionary::train(1, samples);
+    dictionaries.add(dictionary);
+
+    const CodecCase cases[] = {
+        {"store", false, Codec::STORE, false, false},
+        {"fast", false, Codec::FAST, false, false},
+        {"high", false, Codec::HIGH, false, false},
+        {"auto", true, Codec::HIGH, false, false},
+        {"auto_dictionary", true, Codec::HIGH, true, false},
+        {"auto_columnar", true, Codec::HIGH, false, true},
+    };
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"corpus\": {\"blocks\": " << options.blocks << ", \"train_blocks\": " << options.train_blocks
+         << ", \"txs_per_block\": " << options.txs_per_block
+         << ", \"addresses\": " << options.addresses << ", \"proof_bytes\": " << options.proof_bytes
+         << ", \"seed\": " << options.seed << ", \"bytes\": " << corpus_bytes << "},\n";
+    std::vector<size_t> counts = thread_counts(options);
+    json << "  \"threads\": [";
+    for (size_t i = 0; i < counts.size(); i++) {
+        json << (i > 0 ? ", " : "") << counts[i];
+    }
+    json << "],\n";
+    json << "  \"levels\": {\"fast\": " << options.levels.fast << ", \"high\": " << options.levels.high << "},\n";
+    json << "  \"dictionary_bytes\": " << dictionary->get_bytes().size() << ",\n";
+    json << "  \"codecs\": [\n";
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        CaseResult result = run_case(cases[i], corpus, options, dictionaries, dictionary.get());
+        json << "    {\"codec\": \"" << cases[i].name << "\", \"ratio\": " << result.ratio
+             << ", \"compress_mbps\": " << result.compress_mbps << ", \"decompress_mbps\": " << result.decompress_mbps
+             << ", \"p50_us\": " << result.p50_us << ", \"p99_us\": " << result.p99_us
+             << ", \"parallel_compress_mbps\": [";
+        for (size_t t = 0; t < result.parallel_compress_mbps.size(); t++) {
+            json << (t > 0 ? ", " : "") << result.parallel_compress_mbps[t];
+        }
+        json << "]}"
+             << (i + 1 < sizeof(cases) / sizeof(cases[0]) ? "," : "") << "\n";
+    }
+    json << "  ],\n";
+    ArchiveResult archive = run_archive(corpus, options, 4, dictionaries, dictionary.get());
+    json << "  \"archive\": {\"blocks_per_frame\": 4, \"ratio\": " << archive.ratio << ", \"read_p50_us\": " << archive.p50_us
+         << ", \"read_p99_us\": " << archive.p99_us << "}\n}\n";
+    std::cout << json.str();
+    return 0;
+}
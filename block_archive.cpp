@@ -0,0 +1,279 @@
+#include "block_archive.h"
+#include "blockchain.h"
+#include "block_codec.h"
+
+namespace Compcrypt {
+
+namespace {
+
+const size_t GROUP_RECORD_SIZE = 16;
+const size_t BLOCK_RECORD_SIZE = 20;
+const size_t TX_RECORD_SIZE = 4;
+const size_t TRAILER_SIZE = 48;
+
+void put_u32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void put_u64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+uint32_t get_u32(const uint8_t* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+uint64_t get_u64(const uint8_t* in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+} // namespace
+
+ArchiveWriter::ArchiveWriter(size_t blocks_per_frame, const CompressionDictionary* dictionary)
+    : blocks_per_frame(blocks_per_frame == 0 ? 1 : blocks_per_frame), dictionary(dictionary), group_blocks(0),
+      first_height(0), next_height(0) {}
+
+bool ArchiveWriter::add_block(const Block& block) {
+    if (blocks.empty()) {
+        first_height = block.index;
+    } else if (block.index != next_height) {
+        return false;
+    }
+    next_height = block.index + 1;
+
+    std::string encoded = BlockCodec::encode_block(block);
+    BlockEntry entry;
+    entry.group = static_cast<uint32_t>(groups.size());
+    entry.raw_offset = static_cast<uint32_t>(group_records.size());
+    entry.raw_length = static_cast<uint32_t>(encoded.size());
+    entry.first_tx = static_cast<uint32_t>(tx_offsets.size());
+    entry.tx_count = static_cast<uint32_t>(block.transactions.size());
+    blocks.push_back(entry);
+
+    // Transactions follow the header and count back to back, exactly as in the arena
+    uint32_t offset = static_cast<uint32_t>(encoded.size() - block.transactions.byte_size());
+    for (size_t i = 0; i < block.transactions.size(); i++) {
+        tx_offsets.push_back(offset);
+        offset += static_cast<uint32_t>(block.transactions.encoded(i).size());
+    }
+
+    group_records += encoded;
+    if (++group_blocks == blocks_per_frame) {
+        seal_group();
+    }
+    return true;
+}
+
+size_t ArchiveWriter::add_range(const Blockchain& blockchain, uint64_t start, uint64_t end) {
+    size_t added = 0;
+    for (uint64_t height = start; height < end; height++) {
+        std::shared_ptr<Block> block = blockchain.get_block(height);
+        if (!block || !add_block(*block)) {
+            break;
+        }
+        added++;
+    }
+    return added;
+}
+
+void ArchiveWriter::seal_group() {
+    if (group_blocks == 0) {
+        return;
+    }
+    std::string frame = compressor.compress(group_records, dictionary);
+    groups.push_back(GroupEntry{archive.size(), static_cast<uint32_t>(frame.size()), group_blocks});
+    archive += frame;
+    group_records.clear();
+    group_blocks = 0;
+}
+
+std::string ArchiveWriter::finish() {
+    seal_group();
+
+    uint64_t footer_offset = archive.size();
+    archive.reserve(archive.size() + groups.size() * GROUP_RECORD_SIZE + blocks.size() * BLOCK_RECORD_SIZE +
+                    tx_offsets.size() * TX_RECORD_SIZE + TRAILER_SIZE);
+    for (const auto& group : groups) {
+        put_u64(archive, group.offset);
+        put_u32(archive, group.frame_length);
+        put_u32(archive, group.block_count);
+    }
+    for (const auto& block : blocks) {
+        put_u32(archive, block.group);
+        put_u32(archive, block.raw_offset);
+        put_u32(archive, block.raw_length);
+        put_u32(archive, block.first_tx);
+        put_u32(archive, block.tx_count);
+    }
+    for (uint32_t offset : tx_offsets) {
+        put_u32(archive, offset);
+    }
+    put_u64(archive, first_height);
+    put_u64(archive, blocks.size());
+    put_u64(archive, groups.size());
+    put_u64(archive, tx_offsets.size());
+    put_u64(archive, footer_offset);
+    put_u32(archive, ARCHIVE_MAGIC);
+    put_u32(archive, ARCHIVE_VERSION);
+
+    std::string result = std::move(archive);
+    archive.clear();
+    groups.clear();
+    blocks.clear();
+    tx_offsets.clear();
+    return result;
+}
+
+bool ArchiveReader::open(std::string archive_bytes, const DictionaryRegistry* registry) {
+    data = std::move(archive_bytes);
+    dictionaries = registry;
+    count = 0;
+    if (data.size() < TRAILER_SIZE) {
+        return false;
+    }
+
+    const uint8_t* trailer = reinterpret_cast<const uint8_t*>(data.data()) + data.size() - TRAILER_SIZE;
+    if (get_u32(trailer + 40) != ARCHIVE_MAGIC || get_u32(trailer + 44) != ARCHIVE_VERSION) {
+        return false;
+    }
+    uint64_t blocks = get_u64(trailer + 8);
+    group_count = get_u64(trailer + 16);
+    tx_count = get_u64(trailer + 24);
+    footer_offset = get_u64(trailer + 32);
+
+    // The footer must exactly fill the space between the frames and the trailer
+    uint64_t footer_space = data.size() - TRAILER_SIZE;
+    if (footer_offset > footer_space || group_count > footer_space / GROUP_RECORD_SIZE ||
+        blocks > footer_space / BLOCK_RECORD_SIZE || tx_count > footer_space / TX_RECORD_SIZE ||
+        footer_offset + group_count * GROUP_RECORD_SIZE + blocks * BLOCK_RECORD_SIZE + tx_count * TX_RECORD_SIZE != footer_space) {
+        return false;
+    }
+    first = get_u64(trailer);
+    count = blocks;
+    return true;
+}
+
+const uint8_t* ArchiveReader::group_record(uint64_t group) const {
+    return reinterpret_cast<const uint8_t*>(data.data()) + footer_offset + group * GROUP_RECORD_SIZE;
+}
+
+const uint8_t* ArchiveReader::block_record(uint64_t height) const {
+    return reinterpret_cast<const uint8_t*>(data.data()) + footer_offset + group_count * GROUP_RECORD_SIZE +
+           (height - first) * BLOCK_RECORD_SIZE;
+}
+
+uint32_t ArchiveReader::tx_offset(uint64_t entry) const {
+    return get_u32(reinterpret_cast<const uint8_t*>(data.data()) + footer_offset + group_count * GROUP_RECORD_SIZE +
+                   count * BLOCK_RECORD_SIZE + entry * TX_RECORD_SIZE);
+}
+
+std::string_view ArchiveReader::frame_for(uint64_t height) const {
+    if (!contains(height)) {
+        return std::string_view();
+    }
+    uint32_t group = get_u32(block_record(height));
+    if (group >= group_count) {
+        return std::string_view();
+    }
+    const uint8_t* record = group_record(group);
+    uint64_t offset = get_u64(record);
+    uint32_t length = get_u32(record + 8);
+    if (offset > footer_offset || length > footer_offset - offset) {
+        return std::string_view();
+    }
+    return std::string_view(data).substr(offset, length);
+}
+
+// Footer records are not checked against their frame in open(), so the requested length is
+// checked against the frame's own header before the output is sized from it
+bool ArchiveReader::read_prefix(uint64_t height, size_t length, std::string& out) const {
+    std::string_view frame = frame_for(height);
+    FrameHeader header;
+    if (frame.empty() || !parse_frame_header(frame, header)) {
+        return false;
+    }
+    if (length > header.raw_length) {
+        std::cerr << "Archive record for block " << height << " lies past the end of its frame" << std::endl;
+        return false;
+    }
+    thread_local FrameDecompressor decompressor;
+    out.resize(length);
+    try {
+        decompressor.decompress_prefix(frame, reinterpret_cast<uint8_t*>(&out[0]), length, dictionaries);
+    } catch (const std::runtime_error& error) {
+        std::cerr << "Archive frame for block " << height << " is corrupt: " << error.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<Block> ArchiveReader::read_block(uint64_t height) const {
+    if (!contains(height)) {
+        return nullptr;
+    }
+    const uint8_t* record = block_record(height);
+    uint32_t raw_offset = get_u32(record + 4);
+    uint32_t raw_length = get_u32(record + 8);
+
+    // Only the frame's bytes up to the end of this block are inflated
+    std::string raw;
+    if (!read_prefix(height, static_cast<size_t>(raw_offset) + raw_length, raw)) {
+        return nullptr;
+    }
+    return BlockCodec::decode_block(std::string_view(raw).substr(raw_offset, raw_length));
+}
+
+bool ArchiveReader::read_transaction_bytes(uint64_t height, size_t position, std::string& encoded) const {
+    if (!contains(height)) {
+        return false;
+    }
+    const uint8_t* record = block_record(height);
+    uint32_t raw_offset = get_u32(record + 4);
+    uint32_t raw_length = get_u32(record + 8);
+    uint32_t first_tx = get_u32(record + 12);
+    uint32_t block_txs = get_u32(record + 16);
+    if (position >= block_txs || static_cast<uint64_t>(first_tx) + block_txs > tx_count) {
+        return false;
+    }
+
+    uint32_t start = tx_offset(first_tx + position);
+    uint32_t end = position + 1 < block_txs ? tx_offset(first_tx + position + 1) : raw_length;
+    if (start > end || end > raw_length) {
+        return false;
+    }
+
+    // Inflation stops at the end of the transaction; later transactions and blocks are never decoded
+    std::string raw;
+    if (!read_prefix(height, static_cast<size_t>(raw_offset) + end, raw)) {
+        return false;
+    }
+    encoded.assign(raw, raw_offset + start, end - start);
+    return true;
+}
+
+std::shared_ptr<Transaction> ArchiveReader::read_transaction(uint64_t height, size_t position) const {
+    std::string encoded;
+    if (!read_transaction_bytes(height, position, encoded)) {
+        return nullptr;
+    }
+    BlockCodec::TransactionView view;
+    size_t pos = 0;
+    if (!view.parse(encoded, pos) || pos != encoded.size()) {
+        return nullptr;
+    }
+    return BlockCodec::decode_transaction(view);
+}
+
+} // End of namespace Compcrypt
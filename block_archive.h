@@ -0,0 +1,119 @@
+#ifndef BLOCK_ARCHIVE_H
+#define BLOCK_ARCHIVE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "compression.h"
+
+// Seekable compressed archive of a contiguous block range.
+//
+//   frame... | group index | block index | tx offsets | trailer
+//
+// Each frame is an independently decodable Compcrypt frame holding blocks_per_frame encoded
+// blocks back to back. The footer is fixed-width little-endian records, read in place:
+//   group:   u64 offset | u32 frame_length | u32 block_count                      (16 bytes)
+//   block:   u32 group | u32 raw_offset | u32 raw_length | u32 first_tx | u32 tx_count   (20 bytes)
+//   tx:      u32 offset of the transaction inside its encoded block                (4 bytes)
+//   trailer: u64 first_height | u64 block_count | u64 group_count | u64 tx_count |
+//            u64 footer_offset | u32 magic | u32 version                          (48 bytes)
+// A block is found in O(1) from its height, and only its own frame is touched; within the
+// frame, inflation stops at the end of the requested block or transaction.
+namespace Compcrypt {
+
+const uint32_t ARCHIVE_MAGIC = 0x52414343;  // "CCAR"
+const uint32_t ARCHIVE_VERSION = 1;
+
+// Builds an archive from blocks appended in height order
+class ArchiveWriter {
+public:
+    explicit ArchiveWriter(size_t blocks_per_frame = 1, const CompressionDictionary* dictionary = nullptr);
+
+    // Append the next block; false if its height doesn't follow the previous one
+    bool add_block(const Block& block);
+
+    // Append heights [start, end) from a chain (held or archived in its store); returns blocks added
+    size_t add_range(const Blockchain& blockchain, uint64_t start, uint64_t end);
+
+    // Seal the open frame, append the footer and return the archive bytes
+    std::string finish();
+
+    // Blocks added so far
+    size_t block_count() const { return blocks.size(); }
+
+private:
+    struct BlockEntry {
+        uint32_t group;
+        uint32_t raw_offset;   // Offset of the encoded block inside its frame's raw bytes
+        uint32_t raw_length;
+        uint32_t first_tx;     // First entry in tx_offsets
+        uint32_t tx_count;
+    };
+
+    struct GroupEntry {
+        uint64_t offset;
+        uint32_t frame_length;
+        uint32_t block_count;
+    };
+
+    void seal_group();
+
+    size_t blocks_per_frame;
+    const CompressionDictionary* dictionary;
+    std::string archive;          // Sealed frames so far
+    std::string group_records;    // Raw bytes of the open frame
+    uint32_t group_blocks;        // Blocks in the open frame
+    uint64_t first_height;
+    uint64_t next_height;
+    std::vector<GroupEntry> groups;
+    std::vector<BlockEntry> blocks;
+    std::vector<uint32_t> tx_offsets;
+    FrameCompressor compressor;
+};
+
+// Random access to an archive's blocks and transactions
+class ArchiveReader {
+public:
+    // Validate the trailer and footer bounds; no frame is decoded
+    bool open(std::string archive_bytes, const DictionaryRegistry* registry = nullptr);
+
+    // Decode one block (nullptr if the height isn't archived or its frame is corrupt)
+    std::shared_ptr<Block> read_block(uint64_t height) const;
+
+    // Encoded bytes of one transaction, inflating only up to its end
+    bool read_transaction_bytes(uint64_t height, size_t position, std::string& encoded) const;
+
+    // Decode one transaction (nullptr if it isn't archived)
+    std::shared_ptr<Transaction> read_transaction(uint64_t height, size_t position) const;
+
+    // The compressed frame holding a height, as it could be sent to a peer
+    std::string_view frame_for(uint64_t height) const;
+
+    bool contains(uint64_t height) const { return height >= first && height - first < count; }
+    uint64_t first_height() const { return first; }
+    uint64_t next_height() const { return first + count; }
+    uint64_t block_count() const { return count; }
+
+private:
+    const uint8_t* group_record(uint64_t group) const;
+    const uint8_t* block_record(uint64_t height) const;
+    uint32_t tx_offset(uint64_t entry) const;
+
+    // Decode the first length raw bytes of the frame holding height
+    bool read_prefix(uint64_t height, size_t length, std::string& out) const;
+
+    std::string data;
+    const DictionaryRegistry* dictionaries = nullptr;
+    uint64_t first = 0;
+    uint64_t count = 0;
+    uint64_t group_count = 0;
+    uint64_t tx_count = 0;
+    uint64_t footer_offset = 0;
+};
+
+} // End of namespace Compcrypt
+
+#endif // BLOCK_ARCHIVE_H
@@ -0,0 +1,175 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <list>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include "hash256.h"
+
+class Block;
+
+// Counters reported by BlockCache::get_stats()
+struct BlockCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t bytes = 0;      // Charged bytes currently cached
+    size_t entries = 0;
+};
+
+// Byte-budgeted LRU cache of decoded blocks, keyed by block hash.
+// Keys are spread over independently locked shards, each with its own LRU list and an
+// equal share of the budget, so concurrent readers rarely contend. Blocks are charged
+// their encoded size plus a fixed per-entry overhead.
+class BlockCache {
+public:
+    static const size_t ENTRY_OVERHEAD = 256;  // Approximate bookkeeping and object cost per block
+
+    explicit BlockCache(size_t byte_budget = 64 * 1024 * 1024, size_t shard_count = 16)
+        : shards(shard_count == 0 ? 1 : shard_count), hits(0), misses(0), evictions(0) {
+        set_budget(byte_budget);
+    }
+
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    // Cached block (nullptr on a miss); a hit moves it to the front of its shard's LRU list
+    std::shared_ptr<Block> get(const Hash256& hash) {
+        Shard& shard = shard_for(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(hash);
+        if (it == shard.index.end()) {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return it->second->block;
+    }
+
+    // Cached block, or the result of load() (inserted when non-null). load runs unlocked,
+    // so two readers missing on the same block at once may both load it.
+    template <typename Loader>
+    std::shared_ptr<Block> get_or_load(const Hash256& hash, Loader load) {
+        if (std::shared_ptr<Block> cached = get(hash)) {
+            return cached;
+        }
+        auto loaded = load();
+        if (loaded) {
+            put(hash, loaded, loaded->encoded_size);
+        }
+        return loaded;
+    }
+
+    // Insert or refresh a block, evicting least recently used blocks in its shard to stay in budget
+    void put(const Hash256& hash, std::shared_ptr<Block> block, size_t encoded_size) {
+        size_t charge = encoded_size + ENTRY_OVERHEAD;
+        Shard& shard = shard_for(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (charge > shard.budget) {
+            return;  // Would evict the whole shard for a single block
+        }
+
+        auto it = shard.index.find(hash);
+        if (it != shard.index.end()) {
+            shard.bytes -= it->second->charge;
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        }
+        while (shard.bytes + charge > shard.budget && !shard.lru.empty()) {
+            evict_last(shard);
+        }
+        shard.lru.push_front(Entry{hash, std::move(block), charge});
+        shard.index[hash] = shard.lru.begin();
+        shard.bytes += charge;
+    }
+
+    // Drop one block (e.g. replaced by a fork switch)
+    void erase(const Hash256& hash) {
+        Shard& shard = shard_for(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(hash);
+        if (it != shard.index.end()) {
+            shard.bytes -= it->second->charge;
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        }
+    }
+
+    void clear() {
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.lru.clear();
+            shard.index.clear();
+            shard.bytes = 0;
+        }
+    }
+
+    // Change the budget; shards over their new share evict immediately
+    void set_budget(size_t byte_budget) {
+        size_t share = byte_budget / shards.size();
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.budget = share;
+            while (shard.bytes > shard.budget && !shard.lru.empty()) {
+                evict_last(shard);
+            }
+        }
+    }
+
+    BlockCacheStats get_stats() const {
+        BlockCacheStats stats;
+        stats.hits = hits.load(std::memory_order_relaxed);
+        stats.misses = misses.load(std::memory_order_relaxed);
+        stats.evictions = evictions.load(std::memory_order_relaxed);
+        for (const auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            stats.bytes += shard.bytes;
+            stats.entries += shard.index.size();
+        }
+        return stats;
+    }
+
+private:
+    struct Entry {
+        Hash256 hash;
+        std::shared_ptr<Block> block;
+        size_t charge;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> lru;  // Most recently used first
+        std::unordered_map<Hash256, std::list<Entry>::iterator, Hash256Hasher> index;
+        size_t bytes = 0;
+        size_t budget = 0;
+    };
+
+    // Hash256Hasher takes the leading bytes, so shard on a different word of the hash
+    Shard& shard_for(const Hash256& hash) {
+        uint64_t word = 0;
+        for (size_t i = 0; i < sizeof(word); i++) {
+            word |= static_cast<uint64_t>(hash.bytes[hash.bytes.size() - 1 - i]) << (8 * i);
+        }
+        return shards[word % shards.size()];
+    }
+
+    void evict_last(Shard& shard) {
+        shard.bytes -= shard.lru.back().charge;
+        shard.index.erase(shard.lru.back().hash);
+        shard.lru.pop_back();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::vector<Shard> shards;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> evictions;
+};
+
+#endif // BLOCK_CACHE_H
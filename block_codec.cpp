@@ -0,0 +1,221 @@
+#include "block_codec.h"
+#include "blockchain.h"
+#include <cstring>
+
+namespace BlockCodec {
+
+namespace {
+
+size_t string_size(size_t length) {
+    return varint_size(length) + length;
+}
+
+void put_string(std::string& out, std::string_view value) {
+    put_varint(out, value.size());
+    out.append(value.data(), value.size());
+}
+
+bool get_string(std::string_view data, size_t& pos, std::string_view& value) {
+    uint64_t length = 0;
+    if (!get_varint(data, pos, length) || data.size() - pos < length) {
+        return false;
+    }
+    value = data.substr(pos, length);
+    pos += length;
+    return true;
+}
+
+void put_double(std::string& out, double value) {
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>((bits >> (8 * i)) & 0xff));
+    }
+}
+
+bool get_double(std::string_view data, size_t& pos, double& value) {
+    if (data.size() - pos < 8) {
+        return false;
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i) {
+        bits |= static_cast<uint64_t>(static_cast<uint8_t>(data[pos + i])) << (8 * i);
+    }
+    std::memcpy(&value, &bits, sizeof(value));
+    pos += 8;
+    return true;
+}
+
+void put_hash(std::string& out, const Hash256& hash) {
+    out.append(reinterpret_cast<const char*>(hash.bytes.data()), hash.bytes.size());
+}
+
+bool get_hash(std::string_view data, size_t& pos, Hash256& hash) {
+    if (data.size() - pos < hash.bytes.size()) {
+        return false;
+    }
+    std::memcpy(hash.bytes.data(), data.data() + pos, hash.bytes.size());
+    pos += hash.bytes.size();
+    return true;
+}
+
+} // namespace
+
+size_t varint_size(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Only the canonical (shortest) encoding is accepted: digests are taken over the raw bytes, so
+// a padded varint would give one transaction a second id
+bool get_varint(std::string_view data, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        if (shift == 63 && byte > 1) {
+            return false;  // Past 64 bits
+        }
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return byte != 0 || shift == 0;  // A zero final byte is redundant padding
+        }
+    }
+    return false;
+}
+
+bool TransactionView::parse(std::string_view data, size_t& pos) {
+    size_t start = pos;
+    if (!get_string(data, pos, sender) || !get_string(data, pos, receiver) ||
+        !get_double(data, pos, amount) || !get_varint(data, pos, timestamp) ||
+        !get_string(data, pos, snark_proof)) {
+        return false;
+    }
+    bytes = data.substr(start, pos - start);
+    return true;
+}
+
+bool BlockView::parse(std::string_view data) {
+    size_t pos = 0;
+    if (data.empty()) {
+        return false;
+    }
+    version = static_cast<uint8_t>(data[pos++]);
+    if (version != FORMAT_VERSION) {
+        return false;
+    }
+    if (!get_varint(data, pos, index) || !get_hash(data, pos, previous_hash) ||
+        !get_varint(data, pos, timestamp) || !get_string(data, pos, block_proposer) ||
+        !get_hash(data, pos, merkle_root)) {
+        return false;
+    }
+    header_bytes = data.substr(0, pos);
+
+    uint64_t count = 0;
+    if (!get_varint(data, pos, count) || count > data.size() - pos) {
+        return false;
+    }
+    transactions.clear();
+    transactions.resize(count);
+    for (auto& tx : transactions) {
+        if (!tx.parse(data, pos)) {
+            return false;
+        }
+    }
+    return pos == data.size();
+}
+
+size_t encoded_size(const Transaction& tx) {
+    return string_size(tx.sender.size()) + string_size(tx.receiver.size()) + 8 +
+           varint_size(tx.timestamp) + string_size(tx.snark_proof.size());
+}
+
+size_t encoded_header_size(const Block& block) {
+    return 1 + varint_size(block.index) + block.previous_hash.bytes.size() +
+           varint_size(block.timestamp) + string_size(block.block_proposer.size()) +
+           block.merkle_root.bytes.size();
+}
+
+size_t max_block_overhead(size_t proposer_size) {
+    const size_t max_varint = varint_size(UINT64_MAX);
+    return 1 + max_varint + sizeof(Hash256::bytes) + max_varint + string_size(proposer_size) +
+           sizeof(Hash256::bytes) + max_varint;
+}
+
+void encode_transaction(const Transaction& tx, std::string& out) {
+    put_string(out, tx.sender);
+    put_string(out, tx.receiver);
+    put_double(out, tx.amount);
+    put_varint(out, tx.timestamp);
+    put_string(out, tx.snark_proof);
+}
+
+std::string encode_transaction(const Transaction& tx) {
+    std::string out;
+    out.reserve(encoded_size(tx));
+    encode_transaction(tx, out);
+    return out;
+}
+
+void encode_header(const Block& block, std::string& out) {
+    out.push_back(static_cast<char>(FORMAT_VERSION));
+    put_varint(out, block.index);
+    put_hash(out, block.previous_hash);
+    put_varint(out, block.timestamp);
+    put_string(out, block.block_proposer);
+    put_hash(out, block.merkle_root);
+}
+
+std::string encode_header(const Block& block) {
+    std::string out;
+    out.reserve(encoded_header_size(block));
+    encode_header(block, out);
+    return out;
+}
+
+std::string encode_block(const Block& block) {
+    std::string out;
+    out.reserve(block.encoded_size);
+    encode_header(block, out);
+    put_varint(out, block.transactions.size());
+    out.append(block.transactions.encoded_bytes().data(), block.transactions.byte_size());
+    return out;
+}
+
+std::shared_ptr<Transaction> decode_transaction(const TransactionView& view) {
+    return std::make_shared<Transaction>(std::string(view.sender), std::string(view.receiver), view.amount,
+                                         view.timestamp, std::string(view.snark_proof));
+}
+
+std::shared_ptr<Block> decode_block(std::string_view data) {
+    BlockView view;
+    if (!view.parse(data)) {
+        return nullptr;
+    }
+    // The transactions are copied into the block's arena as one contiguous run of bytes
+    TransactionArena transactions;
+    size_t tx_bytes = view.header_bytes.size() < data.size() ? data.size() - view.header_bytes.size() : 0;
+    transactions.reserve(view.transactions.size(), tx_bytes);
+    for (const auto& tx : view.transactions) {
+        transactions.append_encoded(tx.bytes);
+    }
+    std::shared_ptr<Block> block = std::make_shared<Block>(view.index, view.previous_hash, view.timestamp,
+                                                           std::move(transactions), std::string(view.block_proposer));
+    if (block->merkle_root != view.merkle_root || block->merkle_mutated) {
+        return nullptr;
+    }
+    return block;
+}
+
+} // End of namespace BlockCodec
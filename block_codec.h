@@ -0,0 +1,82 @@
+#ifndef BLOCK_CODEC_H
+#define BLOCK_CODEC_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "hash256.h"
+
+// Forward declarations
+class Transaction;
+class Block;
+
+// Canonical binary encoding of blocks and transactions.
+// Hashing, size limits, storage, gossip and compression all consume these bytes.
+//
+// Transaction: str sender | str receiver | f64 amount | varint timestamp | str snark_proof
+// Header:      u8 version | varint index | h256 previous_hash | varint timestamp | str proposer | h256 merkle_root
+// Block:       header | varint transaction count | transaction...
+//
+// str is a varint length followed by the raw bytes; f64 is the 8-byte little-endian IEEE value;
+// h256 is a raw 32-byte hash.
+namespace BlockCodec {
+
+    const uint8_t FORMAT_VERSION = 2;  // v2: hashes are fixed 32-byte fields
+
+    // LEB128 varint helpers (get_varint rejects non-canonical and over-long encodings)
+    size_t varint_size(uint64_t value);
+    void put_varint(std::string& out, uint64_t value);
+    bool get_varint(std::string_view data, size_t& pos, uint64_t& value);
+
+    // Read-only view over an encoded transaction; fields point into the encoded buffer
+    struct TransactionView {
+        std::string_view sender;
+        std::string_view receiver;
+        double amount = 0;
+        uint64_t timestamp = 0;
+        std::string_view snark_proof;
+        std::string_view bytes;     // The whole encoded transaction
+
+        // Parse one transaction starting at pos and advance pos past it
+        bool parse(std::string_view data, size_t& pos);
+    };
+
+    // Read-only view over an encoded block; nothing is copied out of the buffer
+    struct BlockView {
+        uint8_t version = 0;
+        uint64_t index = 0;
+        Hash256 previous_hash;
+        uint64_t timestamp = 0;
+        std::string_view block_proposer;
+        Hash256 merkle_root;
+        std::string_view header_bytes;                 // Bytes hashed into the block hash
+        std::vector<TransactionView> transactions;
+
+        bool parse(std::string_view data);
+    };
+
+    // Exact encoded sizes, computed without encoding
+    size_t encoded_size(const Transaction& tx);
+    size_t encoded_header_size(const Block& block);
+
+    // Largest header plus transaction-count size of any block whose proposer name is
+    // proposer_size bytes: what a block spends outside its transactions
+    size_t max_block_overhead(size_t proposer_size);
+
+    // Encoders
+    void encode_transaction(const Transaction& tx, std::string& out);
+    std::string encode_transaction(const Transaction& tx);
+    void encode_header(const Block& block, std::string& out);
+    std::string encode_header(const Block& block);
+    std::string encode_block(const Block& block);
+
+    // Decoders (nullptr if the bytes are malformed or the Merkle root doesn't match)
+    std::shared_ptr<Transaction> decode_transaction(const TransactionView& view);
+    std::shared_ptr<Block> decode_block(std::string_view data);
+
+} // End of namespace BlockCodec
+
+#endif // BLOCK_CODEC_H
@@ -0,0 +1,258 @@
+#include "block_columns.h"
+#include "block_codec.h"
+#include <unordered_map>
+#include <cstring>
+#include <cmath>
+
+namespace BlockColumns {
+
+namespace {
+
+// Amounts beyond this can't be scaled to units without overflowing int64
+const double MAX_UNITS_AMOUNT = 9e10;
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+uint64_t double_bits(double value) {
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double bits_double(uint64_t bits) {
+    double value = 0;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Units of 1e-8 for an amount, if scaling back reproduces the exact same double
+bool to_units(double amount, int64_t& units) {
+    if (!(std::fabs(amount) < MAX_UNITS_AMOUNT)) {
+        return false;  // Also rejects NaN and infinities
+    }
+    units = std::llround(amount * UNITS_PER_COIN);
+    return double_bits(static_cast<double>(units) / UNITS_PER_COIN) == double_bits(amount);
+}
+
+void put_string(std::string& out, std::string_view value) {
+    BlockCodec::put_varint(out, value.size());
+    out.append(value.data(), value.size());
+}
+
+bool get_string(std::string_view data, size_t& pos, std::string_view& value) {
+    uint64_t length = 0;
+    if (!BlockCodec::get_varint(data, pos, length) || data.size() - pos < length) {
+        return false;
+    }
+    value = data.substr(pos, length);
+    pos += length;
+    return true;
+}
+
+// Slice off a column of count varints starting at pos
+bool get_varint_column(std::string_view data, size_t& pos, uint64_t count, std::string_view& column) {
+    size_t start = pos;
+    uint64_t value = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        if (!BlockCodec::get_varint(data, pos, value)) {
+            return false;
+        }
+    }
+    column = data.substr(start, pos - start);
+    return true;
+}
+
+// Reassemble value i of a byte-plane column
+uint64_t gather(std::string_view planes, uint64_t count, size_t i) {
+    uint64_t value = 0;
+    for (int plane = 0; plane < 8; plane++) {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(planes[plane * count + i])) << (8 * plane);
+    }
+    return value;
+}
+
+} // namespace
+
+bool encode(std::string_view block_bytes, std::string& out) {
+    BlockCodec::BlockView block;
+    if (!block.parse(block_bytes)) {
+        return false;
+    }
+    const std::vector<BlockCodec::TransactionView>& txs = block.transactions;
+    size_t count = txs.size();
+
+    // Address table and the id columns
+    std::unordered_map<std::string_view, uint64_t> address_ids;
+    std::vector<std::string_view> addresses;
+    std::string sender_ids;
+    std::string receiver_ids;
+    auto address_id = [&](std::string_view address) {
+        auto inserted = address_ids.emplace(address, addresses.size());
+        if (inserted.second) {
+            addresses.push_back(address);
+        }
+        return inserted.first->second;
+    };
+    for (const auto& tx : txs) {
+        BlockCodec::put_varint(sender_ids, address_id(tx.sender));
+        BlockCodec::put_varint(receiver_ids, address_id(tx.receiver));
+    }
+
+    // Fixed-point units only if every amount survives the round trip
+    std::vector<uint64_t> amounts(count);
+    uint8_t amount_mode = AMOUNT_UNITS;
+    for (size_t i = 0; i < count && amount_mode == AMOUNT_UNITS; i++) {
+        int64_t units = 0;
+        if (to_units(txs[i].amount, units)) {
+            amounts[i] = static_cast<uint64_t>(units);
+        } else {
+            amount_mode = AMOUNT_IEEE;
+        }
+    }
+    if (amount_mode == AMOUNT_IEEE) {
+        for (size_t i = 0; i < count; i++) {
+            amounts[i] = double_bits(txs[i].amount);
+        }
+    }
+
+    out.clear();
+    out.reserve(block_bytes.size() + count * 8);
+
+    out.push_back(static_cast<char>(FORMAT_VERSION));
+    put_string(out, block.header_bytes);
+    BlockCodec::put_varint(out, count);
+    BlockCodec::put_varint(out, addresses.size());
+    for (std::string_view address : addresses) {
+        put_string(out, address);
+    }
+    out += sender_ids;
+    out += receiver_ids;
+    uint64_t previous = 0;
+    for (const auto& tx : txs) {
+        BlockCodec::put_varint(out, zigzag(static_cast<int64_t>(tx.timestamp - previous)));
+        previous = tx.timestamp;
+    }
+    out.push_back(static_cast<char>(amount_mode));
+    for (int plane = 0; plane < 8; plane++) {
+        for (size_t i = 0; i < count; i++) {
+            out.push_back(static_cast<char>(amounts[i] >> (8 * plane)));
+        }
+    }
+    for (const auto& tx : txs) {
+        BlockCodec::put_varint(out, tx.snark_proof.size());
+    }
+    for (const auto& tx : txs) {
+        out.append(tx.snark_proof.data(), tx.snark_proof.size());
+    }
+    return true;
+}
+
+bool ColumnsView::parse(std::string_view data) {
+    size_t pos = 0;
+    if (data.empty() || static_cast<uint8_t>(data[pos++]) != FORMAT_VERSION) {
+        return false;
+    }
+    uint64_t address_count = 0;
+    if (!get_string(data, pos, header_bytes) || !BlockCodec::get_varint(data, pos, tx_count) ||
+        tx_count > data.size() - pos || !BlockCodec::get_varint(data, pos, address_count) ||
+        address_count > data.size() - pos) {
+        return false;
+    }
+    addresses.resize(address_count);
+    for (auto& address : addresses) {
+        if (!get_string(data, pos, address)) {
+            return false;
+        }
+    }
+    if (!get_varint_column(data, pos, tx_count, sender_ids) || !get_varint_column(data, pos, tx_count, receiver_ids) ||
+        !get_varint_column(data, pos, tx_count, timestamps) || pos >= data.size()) {
+        return false;
+    }
+    amount_mode = static_cast<uint8_t>(data[pos++]);
+    if ((amount_mode != AMOUNT_UNITS && amount_mode != AMOUNT_IEEE) || (data.size() - pos) / 8 < tx_count) {
+        return false;
+    }
+    amount_planes = data.substr(pos, tx_count * 8);
+    pos += tx_count * 8;
+    if (!get_varint_column(data, pos, tx_count, proof_lengths)) {
+        return false;
+    }
+    proofs = data.substr(pos);
+    return true;
+}
+
+double ColumnsView::amount(size_t i) const {
+    uint64_t value = gather(amount_planes, tx_count, i);
+    if (amount_mode == AMOUNT_UNITS) {
+        return static_cast<double>(static_cast<int64_t>(value)) / UNITS_PER_COIN;
+    }
+    return bits_double(value);
+}
+
+double ColumnsView::total_amount() const {
+    if (amount_mode == AMOUNT_UNITS) {
+        uint64_t units = 0;  // Unsigned so wrap-around is defined; exact while the total fits int64
+        for (size_t i = 0; i < tx_count; i++) {
+            units += gather(amount_planes, tx_count, i);
+        }
+        return static_cast<double>(static_cast<int64_t>(units)) / UNITS_PER_COIN;
+    }
+    double total = 0;
+    for (size_t i = 0; i < tx_count; i++) {
+        total += amount(i);
+    }
+    return total;
+}
+
+bool decode(std::string_view columns, std::string& block_bytes) {
+    ColumnsView view;
+    if (!view.parse(columns)) {
+        return false;
+    }
+
+    block_bytes.clear();
+    block_bytes.reserve(columns.size());
+    block_bytes.append(view.header_bytes.data(), view.header_bytes.size());
+    BlockCodec::put_varint(block_bytes, view.tx_count);
+
+    size_t sender_pos = 0;
+    size_t receiver_pos = 0;
+    size_t timestamp_pos = 0;
+    size_t length_pos = 0;
+    size_t proof_pos = 0;
+    uint64_t timestamp = 0;
+    for (size_t i = 0; i < view.tx_count; i++) {
+        uint64_t sender = 0;
+        uint64_t receiver = 0;
+        uint64_t delta = 0;
+        uint64_t proof_length = 0;
+        BlockCodec::get_varint(view.sender_ids, sender_pos, sender);
+        BlockCodec::get_varint(view.receiver_ids, receiver_pos, receiver);
+        BlockCodec::get_varint(view.timestamps, timestamp_pos, delta);
+        BlockCodec::get_varint(view.proof_lengths, length_pos, proof_length);
+        if (sender >= view.addresses.size() || receiver >= view.addresses.size() ||
+            proof_length > view.proofs.size() - proof_pos) {
+            return false;
+        }
+        timestamp += static_cast<uint64_t>(unzigzag(delta));
+
+        put_string(block_bytes, view.addresses[sender]);
+        put_string(block_bytes, view.addresses[receiver]);
+        uint64_t bits = double_bits(view.amount(i));
+        for (int byte = 0; byte < 8; byte++) {
+            block_bytes.push_back(static_cast<char>(bits >> (8 * byte)));
+        }
+        BlockCodec::put_varint(block_bytes, timestamp);
+        put_string(block_bytes, view.proofs.substr(proof_pos, proof_length));
+        proof_pos += proof_length;
+    }
+    return proof_pos == view.proofs.size();
+}
+
+} // End of namespace BlockColumns
@@ -0,0 +1,69 @@
+#ifndef BLOCK_COLUMNS_H
+#define BLOCK_COLUMNS_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Columnar rewrite of an encoded block, applied before compression (see compress_block_data).
+// The row-wise transaction encoding interleaves addresses, amounts, timestamps and proofs;
+// grouping each field into its own column puts similar bytes next to each other and keeps
+// the incompressible proofs out of the way of everything else.
+//
+//   u8 version | str header | varint tx_count
+//   varint address_count | str address...       per-block table, first-seen order
+//   varint sender_id...                          one per transaction
+//   varint receiver_id...
+//   varint timestamp_delta...                    zigzag delta from the previous transaction
+//   u8 amount_mode | amount planes               tx_count 8-byte values, byte 0 of every value first
+//   varint proof_length...
+//   proof bytes                                  concatenated
+//
+// header is the canonical block header, kept verbatim. Amounts are fixed-point units of
+// 1e-8 when every amount in the block round-trips through them exactly, else raw IEEE bits.
+// decode() rebuilds the canonical encoding byte for byte, so hashes are unaffected.
+namespace BlockColumns {
+
+    const uint8_t FORMAT_VERSION = 1;
+
+    enum AmountMode : uint8_t {
+        AMOUNT_UNITS = 0,     // int64 count of 1e-8
+        AMOUNT_IEEE = 1       // Raw double bits
+    };
+
+    const double UNITS_PER_COIN = 1e8;
+
+    // Rewrite a canonically encoded block as columns; false if the block doesn't parse
+    bool encode(std::string_view block_bytes, std::string& out);
+
+    // Rebuild the canonical block encoding from its columns; false if they are malformed
+    bool decode(std::string_view columns, std::string& block_bytes);
+
+    // Read-only view over columnar bytes. Columns can be scanned without rebuilding rows,
+    // e.g. summing amounts reads only the amount planes.
+    struct ColumnsView {
+        std::string_view header_bytes;
+        uint64_t tx_count = 0;
+        std::vector<std::string_view> addresses;
+        std::string_view sender_ids;       // tx_count varints
+        std::string_view receiver_ids;     // tx_count varints
+        std::string_view timestamps;       // tx_count zigzag varints
+        uint8_t amount_mode = AMOUNT_UNITS;
+        std::string_view amount_planes;    // 8 * tx_count bytes
+        std::string_view proof_lengths;    // tx_count varints
+        std::string_view proofs;
+
+        bool parse(std::string_view data);
+
+        // Amount of the transaction at position i; O(1)
+        double amount(size_t i) const;
+
+        // Sum of every amount in the block (exact in units mode)
+        double total_amount() const;
+    };
+
+} // End of namespace BlockColumns
+
+#endif // BLOCK_COLUMNS_H
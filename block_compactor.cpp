@@ -0,0 +1,315 @@
+#include "block_compactor.h"
+#include "blockchain.h"
+#include "block_codec.h"
+#include "compression.h"
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Compcrypt {
+
+BlockCompactor::BlockCompactor(const DictionaryRegistry* registry, CompactionPolicy policy)
+    : dictionaries(registry), policy(policy), epoch(std::chrono::steady_clock::now()), newest_height(0), spill_height(0),
+      hot_count(0), cold_count(0), hot_bytes(0), cold_bytes(0), batches(0), compacted(0), spilled(0), stopping(false) {}
+
+BlockCompactor::~BlockCompactor() {
+    stop();
+}
+
+int64_t BlockCompactor::now_ms() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void BlockCompactor::track(std::shared_ptr<Block> block) {
+    std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+    entry->height = block->index;
+    entry->hash = block->get_block_hash();
+    entry->hot_size = block->encoded_size;
+    entry->last_read_ms.store(-1);
+    entry->form = std::make_shared<const Form>(Form{std::move(block), std::string()});
+
+    {
+        std::unique_lock<std::shared_mutex> lock(index_mutex);
+        if (by_hash.count(entry->hash)) {
+            return;
+        }
+        // A replaced tip: the old blocks at this height and above are no longer on the chain
+        auto replaced = by_height.lower_bound(entry->height);
+        while (replaced != by_height.end()) {
+            erase_locked(replaced->second);
+            replaced = by_height.erase(replaced);
+        }
+        // Charged before the entry is visible, so a concurrent forget can't underflow the counters
+        hot_count++;
+        hot_bytes += entry->hot_size;
+        by_hash[entry->hash] = entry;
+        by_height[entry->height] = entry;
+        newest_height.store(entry->height);
+    }
+
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    while (!hot_queue.empty() && !std::atomic_load(&hot_queue.front()->form)) {
+        hot_queue.pop_front();  // Forgotten while waiting
+    }
+    hot_queue.push_back(std::move(entry));
+}
+
+// Detach an entry's form and uncharge it; the caller removes it from by_height
+void BlockCompactor::erase_locked(const std::shared_ptr<Entry>& entry) {
+    by_hash.erase(entry->hash);
+    std::shared_ptr<const Form> form = std::atomic_exchange(&entry->form, std::shared_ptr<const Form>());
+    if (!form) {
+        return;
+    }
+    if (form->block) {
+        hot_count--;
+        hot_bytes -= entry->hot_size;
+    } else {
+        cold_count--;
+        cold_bytes -= form->frame.size();
+    }
+}
+
+void BlockCompactor::forget(const Hash256& hash) {
+    std::unique_lock<std::shared_mutex> lock(index_mutex);
+    auto it = by_hash.find(hash);
+    if (it == by_hash.end()) {
+        return;
+    }
+    std::shared_ptr<Entry> entry = it->second;
+    erase_locked(entry);
+    auto at_height = by_height.find(entry->height);
+    if (at_height != by_height.end() && at_height->second == entry) {
+        by_height.erase(at_height);
+    }
+}
+
+void BlockCompactor::prune_below(uint64_t height) {
+    std::unique_lock<std::shared_mutex> lock(index_mutex);
+    for (auto it = by_height.begin(); it != by_height.end() && it->first < height;) {
+        erase_locked(it->second);
+        it = by_height.erase(it);
+    }
+}
+
+bool BlockCompactor::contains(const Hash256& hash) const {
+    std::shared_lock<std::shared_mutex> lock(index_mutex);
+    return by_hash.count(hash) > 0;
+}
+
+uint64_t BlockCompactor::next_height() const {
+    std::shared_lock<std::shared_mutex> lock(index_mutex);
+    return by_height.empty() ? 0 : by_height.rbegin()->first + 1;
+}
+
+std::shared_ptr<BlockCompactor::Entry> BlockCompactor::find(const Hash256& hash) const {
+    std::shared_lock<std::shared_mutex> lock(index_mutex);
+    auto it = by_hash.find(hash);
+    return it == by_hash.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<Block> BlockCompactor::find_hot(const Hash256& hash) {
+    std::shared_ptr<Entry> entry = find(hash);
+    if (!entry) {
+        return nullptr;
+    }
+    std::shared_ptr<const Form> form = std::atomic_load(&entry->form);
+    if (!form || !form->block) {
+        return nullptr;
+    }
+    entry->last_read_ms.store(now_ms(), std::memory_order_relaxed);
+    return form->block;
+}
+
+std::shared_ptr<Block> BlockCompactor::load(const Hash256& hash) {
+    std::shared_ptr<Entry> entry = find(hash);
+    if (!entry) {
+        return nullptr;
+    }
+    std::shared_ptr<const Form> form = std::atomic_load(&entry->form);
+    if (!form) {
+        return nullptr;
+    }
+    entry->last_read_ms.store(now_ms(), std::memory_order_relaxed);
+    if (form->block) {
+        return form->block;
+    }
+    try {
+        return BlockCodec::decode_block(decompress_data(form->frame, dictionaries));
+    } catch (const std::runtime_error& error) {
+        std::cerr << "Compacted block " << entry->height << " is corrupt: " << error.what() << std::endl;
+        return nullptr;
+    }
+}
+
+std::shared_ptr<Block> BlockCompactor::load_height(uint64_t height) {
+    Hash256 hash;
+    {
+        std::shared_lock<std::shared_mutex> lock(index_mutex);
+        auto it = by_height.find(height);
+        if (it == by_height.end()) {
+            return nullptr;
+        }
+        hash = it->second->hash;
+    }
+    return load(hash);
+}
+
+void BlockCompactor::set_dictionary(std::shared_ptr<const CompressionDictionary> new_dictionary) {
+    std::atomic_store(&dictionary, std::move(new_dictionary));
+}
+
+// Pop cold blocks off the front of the hot queue until the batch is full or would bring the
+// footprint down to the target. Blocks read within idle_time go to the back instead.
+std::vector<std::shared_ptr<BlockCompactor::Entry>> BlockCompactor::take_candidates() {
+    std::vector<std::shared_ptr<Entry>> batch;
+    size_t size = footprint();
+    if (size <= policy.footprint_target) {
+        return batch;
+    }
+    size_t excess = size - policy.footprint_target;
+    size_t selected = 0;
+    uint64_t newest = newest_height.load();
+    int64_t now = now_ms();
+
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    for (size_t scanned = 0, limit = hot_queue.size();
+         scanned < limit && !hot_queue.empty() && batch.size() < policy.batch_blocks && selected < excess; scanned++) {
+        std::shared_ptr<Entry> entry = hot_queue.front();
+        std::shared_ptr<const Form> form = std::atomic_load(&entry->form);
+        if (!form || !form->block) {
+            hot_queue.pop_front();  // Forgotten
+            continue;
+        }
+        if (entry->height + policy.cold_age > newest) {
+            break;  // Queued in tracking order, so the rest are as young or were just requeued
+        }
+        hot_queue.pop_front();
+        int64_t last_read = entry->last_read_ms.load(std::memory_order_relaxed);
+        if (last_read >= 0 && now - last_read < policy.idle_time.count()) {
+            hot_queue.push_back(std::move(entry));
+            continue;
+        }
+        selected += entry->hot_size;
+        batch.push_back(std::move(entry));
+    }
+    return batch;
+}
+
+std::vector<std::pair<uint64_t, Hash256>> BlockCompactor::take_compacted() {
+    std::vector<std::pair<uint64_t, Hash256>> taken;
+    std::lock_guard<std::mutex> lock(compacted_mutex);
+    taken.swap(recently_compacted);
+    return taken;
+}
+
+// Oldest first, drop frames of blocks below the spill height while the footprint is over the
+// target; hot blocks are left to compaction
+size_t BlockCompactor::spill() {
+    uint64_t limit = spill_height.load();
+    size_t dropped = 0;
+    std::unique_lock<std::shared_mutex> lock(index_mutex);
+    for (auto it = by_height.begin(); it != by_height.end() && it->first < limit && footprint() > policy.footprint_target;) {
+        std::shared_ptr<const Form> form = std::atomic_load(&it->second->form);
+        if (!form || form->block) {
+            ++it;
+            continue;
+        }
+        erase_locked(it->second);
+        it = by_height.erase(it);
+        dropped++;
+    }
+    spilled += dropped;
+    return dropped;
+}
+
+size_t BlockCompactor::compact_batch() {
+    std::vector<std::shared_ptr<Entry>> batch = take_candidates();
+    if (batch.empty()) {
+        spill();
+        return 0;
+    }
+
+    std::shared_ptr<const CompressionDictionary> current = std::atomic_load(&dictionary);
+    size_t done = 0;
+    for (const auto& entry : batch) {
+        std::shared_ptr<const Form> hot = std::atomic_load(&entry->form);
+        if (!hot || !hot->block) {
+            continue;
+        }
+        std::shared_ptr<Form> cold = std::make_shared<Form>();
+        cold->frame = compress_block_data(BlockCodec::encode_block(*hot->block), current.get());
+        size_t frame_size = cold->frame.size();
+
+        // Publish only if the block wasn't forgotten meanwhile; readers holding the hot form keep it
+        cold_count++;
+        cold_bytes += frame_size;
+        if (std::atomic_compare_exchange_strong(&entry->form, &hot, std::shared_ptr<const Form>(std::move(cold)))) {
+            hot_count--;
+            hot_bytes -= entry->hot_size;
+            done++;
+            std::lock_guard<std::mutex> lock(compacted_mutex);
+            recently_compacted.emplace_back(entry->height, entry->hash);
+        } else {
+            cold_count--;
+            cold_bytes -= frame_size;
+        }
+    }
+    batches++;
+    compacted += done;
+    spill();
+    return done;
+}
+
+void BlockCompactor::start() {
+    if (worker.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex);
+        stopping = false;
+    }
+    worker = std::thread([this] { worker_loop(); });
+}
+
+void BlockCompactor::stop() {
+    if (!worker.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    worker.join();
+}
+
+void BlockCompactor::worker_loop() {
+#ifdef __linux__
+    // Linux applies nice values per thread, so only the compactor is deprioritized
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+    std::unique_lock<std::mutex> lock(worker_mutex);
+    while (!stopping) {
+        lock.unlock();
+        compact_batch();
+        lock.lock();
+        wakeup.wait_for(lock, policy.batch_interval, [this] { return stopping; });
+    }
+}
+
+CompactionStats BlockCompactor::get_stats() const {
+    CompactionStats stats;
+    stats.hot_blocks = hot_count.load();
+    stats.cold_blocks = cold_count.load();
+    stats.hot_bytes = hot_bytes.load();
+    stats.cold_bytes = cold_bytes.load();
+    stats.batches = batches.load();
+    stats.compacted = compacted.load();
+    stats.spilled = spilled.load();
+    return stats;
+}
+
+} // End of namespace Compcrypt
@@ -0,0 +1,165 @@
+#ifndef BLOCK_COMPACTOR_H
+#define BLOCK_COMPACTOR_H
+
+#include <map>
+#include <deque>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include "hash256.h"
+
+class Block;
+
+namespace Compcrypt {
+
+class CompressionDictionary;
+class DictionaryRegistry;
+
+// When a tracked block counts as cold, and how fast cold blocks are compacted
+struct CompactionPolicy {
+    uint64_t cold_age = 64;                             // Heights below the newest tracked block before a block may go cold
+    std::chrono::milliseconds idle_time{2000};          // A block read more recently than this stays hot
+    size_t batch_blocks = 32;                           // Most blocks compacted per batch
+    std::chrono::milliseconds batch_interval{50};       // Pause between batches (rate limit)
+    size_t footprint_target = 64 * 1024 * 1024;         // Compaction stops once hot + cold bytes fit, then frames spill
+};
+
+// Counters reported by BlockCompactor::get_stats()
+struct CompactionStats {
+    size_t hot_blocks = 0;
+    size_t cold_blocks = 0;
+    size_t hot_bytes = 0;       // Encoded size of blocks held as objects
+    size_t cold_bytes = 0;      // Size of the compressed frames
+    uint64_t batches = 0;
+    uint64_t compacted = 0;
+    uint64_t spilled = 0;       // Frames dropped because the block is durable elsewhere
+};
+
+// Two-tier block store: blocks are tracked hot (as shared Block objects) and a low-priority
+// background thread compresses the cold ones in small batches while the footprint is above
+// the target. Temperature is age in heights plus time since the last read; hot blocks wait
+// in a FIFO, and an old block read within idle_time gets a second chance at the back.
+//
+// Each block's current form sits behind a shared_ptr that is swapped atomically, so a read
+// never waits on compression: it sees either the hot block or the finished frame. The writer
+// thread only takes short locks to track blocks.
+//
+// Compacted blocks are reported through take_compacted() so the owner can drop its own
+// references. If frames alone keep the footprint above the target, the oldest frames below
+// the spill height (blocks the owner can reload from disk or an archive) are dropped.
+class BlockCompactor {
+public:
+    explicit BlockCompactor(const DictionaryRegistry* registry = nullptr, CompactionPolicy policy = CompactionPolicy());
+    ~BlockCompactor();
+
+    BlockCompactor(const BlockCompactor&) = delete;
+    BlockCompactor& operator=(const BlockCompactor&) = delete;
+
+    // Track a newly connected block (hot). A different block at an already tracked height
+    // means the tip was replaced, so that height and everything above it is forgotten.
+    void track(std::shared_ptr<Block> block);
+
+    // Stop tracking one block / every block below a height
+    void forget(const Hash256& hash);
+    void prune_below(uint64_t height);
+
+    bool contains(const Hash256& hash) const;
+
+    // Next height after the newest tracked block (0 when empty)
+    uint64_t next_height() const;
+
+    // The block if it is still hot (marks it as read), else nullptr
+    std::shared_ptr<Block> find_hot(const Hash256& hash);
+
+    // The block in either form; cold blocks are decompressed (nullptr if unknown or corrupt)
+    std::shared_ptr<Block> load(const Hash256& hash);
+
+    // The block tracked at a height, in either form (nullptr if none)
+    std::shared_ptr<Block> load_height(uint64_t height);
+
+    // Blocks compacted since the last call, as (height, hash)
+    std::vector<std::pair<uint64_t, Hash256>> take_compacted();
+
+    // Frames of blocks below this height may be dropped to meet the footprint target
+    void set_spill_height(uint64_t height) { spill_height.store(height); }
+
+    // Dictionary for frames compacted from now on (registered in the registry by the caller)
+    void set_dictionary(std::shared_ptr<const CompressionDictionary> dictionary);
+
+    // Compact one batch of cold blocks on the calling thread; returns blocks compacted
+    size_t compact_batch();
+
+    // Run compact_batch() every batch_interval on a background thread
+    void start();
+    void stop();
+    bool running() const { return worker.joinable(); }
+
+    size_t footprint() const { return hot_bytes.load() + cold_bytes.load(); }
+    CompactionStats get_stats() const;
+
+private:
+    // A block's current form: exactly one of block / frame is set
+    struct Form {
+        std::shared_ptr<Block> block;
+        std::string frame;
+    };
+
+    struct Entry {
+        uint64_t height;
+        Hash256 hash;
+        size_t hot_size;                       // Encoded size, charged while hot
+        std::atomic<int64_t> last_read_ms;     // Milliseconds since construction (-1 = never read)
+        std::shared_ptr<const Form> form;      // Swapped with std::atomic_*; nullptr once forgotten
+    };
+
+    std::shared_ptr<Entry> find(const Hash256& hash) const;
+    void erase_locked(const std::shared_ptr<Entry>& entry);
+    std::vector<std::shared_ptr<Entry>> take_candidates();
+    size_t spill();
+    int64_t now_ms() const;
+    void worker_loop();
+
+    const DictionaryRegistry* dictionaries;
+    CompactionPolicy policy;
+    std::shared_ptr<const CompressionDictionary> dictionary;  // Swapped with std::atomic_*
+    std::chrono::steady_clock::time_point epoch;
+
+    mutable std::shared_mutex index_mutex;  // Guards by_hash and by_height
+    std::unordered_map<Hash256, std::shared_ptr<Entry>, Hash256Hasher> by_hash;
+    std::map<uint64_t, std::shared_ptr<Entry>> by_height;
+
+    std::mutex queue_mutex;  // Guards hot_queue
+    std::deque<std::shared_ptr<Entry>> hot_queue;  // Hot blocks in tracking order
+
+    std::mutex compacted_mutex;  // Guards recently_compacted
+    std::vector<std::pair<uint64_t, Hash256>> recently_compacted;
+
+    std::atomic<uint64_t> newest_height;
+    std::atomic<uint64_t> spill_height;
+    std::atomic<size_t> hot_count;
+    std::atomic<size_t> cold_count;
+    std::atomic<size_t> hot_bytes;
+    std::atomic<size_t> cold_bytes;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> compacted;
+    std::atomic<uint64_t> spilled;
+
+    std::mutex worker_mutex;
+    std::condition_variable wakeup;
+    bool stopping;
+    std::thread worker;
+};
+
+} // End of namespace Compcrypt
+
+#endif // BLOCK_COMPACTOR_H
@@ -0,0 +1,99 @@
+#ifndef BLOCK_RING_H
+#define BLOCK_RING_H
+
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+
+class Block;
+
+// Fixed-capacity ring buffer of blocks indexed by height.
+// Heights held are always contiguous [first_height(), next_height()), so the slot
+// of a height is simply height % capacity and appends/evictions never shift memory.
+class BlockRing {
+public:
+    explicit BlockRing(size_t capacity)
+        : slots(capacity == 0 ? 1 : capacity), first(0), count(0) {}
+
+    size_t size() const { return count; }
+    size_t capacity() const { return slots.size(); }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == slots.size(); }
+
+    // Height of the oldest block still held
+    uint64_t first_height() const { return first; }
+
+    // Height the next appended block must have
+    uint64_t next_height() const { return first + count; }
+
+    // Whether the block at this height is still held
+    bool contains(uint64_t height) const {
+        return height >= first && height < next_height();
+    }
+
+    // Unchecked lookup by height (nullptr if the slot was released)
+    const std::shared_ptr<Block>& operator[](uint64_t height) const {
+        return slots[height % slots.size()];
+    }
+
+    // Checked lookup by height
+    const std::shared_ptr<Block>& at(uint64_t height) const {
+        if (!contains(height)) {
+            throw std::out_of_range("Block height not held by the chain!");
+        }
+        return (*this)[height];
+    }
+
+    const std::shared_ptr<Block>& front() const { return (*this)[first]; }
+    const std::shared_ptr<Block>& back() const { return (*this)[next_height() - 1]; }
+
+    // Append a block at next_height(); the caller evicts first when full
+    void push_back(std::shared_ptr<Block> block) {
+        if (full()) {
+            throw std::length_error("Block ring is full!");
+        }
+        slots[next_height() % slots.size()] = std::move(block);
+        count++;
+    }
+
+    // Drop the ring's reference to a held block; the height stays held, so a compacted copy
+    // elsewhere can be the only one in memory
+    void release(uint64_t height) {
+        if (contains(height)) {
+            slots[height % slots.size()].reset();
+        }
+    }
+
+    // Remove and return the oldest block (nullptr if its slot was released)
+    std::shared_ptr<Block> pop_front() {
+        std::shared_ptr<Block> block = std::move(slots[first % slots.size()]);
+        first++;
+        count--;
+        return block;
+    }
+
+    // Remove and return the newest block (unapplying a block during a fork switch; nullptr if released)
+    std::shared_ptr<Block> pop_back() {
+        std::shared_ptr<Block> block = std::move(slots[(next_height() - 1) % slots.size()]);
+        count--;
+        return block;
+    }
+
+    // Drop every block and start empty at the given height (e.g. when resuming from a store)
+    void reset(uint64_t height) {
+        for (auto& slot : slots) {
+            slot.reset();
+        }
+        first = height;
+        count = 0;
+    }
+
+private:
+    std::vector<std::shared_ptr<Block>> slots;  // Slot for height h is h % capacity
+    uint64_t first;                             // Height of the oldest held block
+    size_t count;                               // Number of held blocks
+};
+
+#endif // BLOCK_RING_H
@@ -0,0 +1,398 @@
+#include "block_store.h"
+#include "blockchain.h"
+#include "block_codec.h"
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const uint64_t INDEX_MAGIC = 0x32584449544e5250ull;  // "PRNTIDX2"
+const uint64_t INITIAL_INDEX_CAPACITY = 4096;         // Records preallocated in a new index file
+
+// Write the whole buffer, retrying on short writes
+bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+uint64_t file_size(const std::string& path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+}
+
+} // namespace
+
+BlockStore::BlockStore(const BlockStoreOptions& opts)
+    : options(opts), index_fd(-1), index_map(nullptr), index_capacity(0), segment_fd(-1),
+      active_segment(0), active_size(0), pending_syncs(0) {}
+
+BlockStore::~BlockStore() {
+    flush();
+    unmap_all();
+    if (segment_fd >= 0) {
+        ::close(segment_fd);
+    }
+    if (index_fd >= 0) {
+        ::close(index_fd);
+    }
+}
+
+std::string BlockStore::segment_path(uint32_t segment) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "blk%05u.dat", segment);
+    return options.directory + "/" + name;
+}
+
+// Create or map the index, validate its tail against the segments and map sealed segments
+bool BlockStore::open() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (::mkdir(options.directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Block store: cannot create " << options.directory << std::endl;
+        return false;
+    }
+
+    std::string index_path = options.directory + "/index.dat";
+    index_fd = ::open(index_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (index_fd < 0) {
+        std::cerr << "Block store: cannot open " << index_path << std::endl;
+        return false;
+    }
+
+    uint64_t size = file_size(index_path);
+    bool fresh = size < sizeof(IndexHeader);
+    uint64_t capacity = fresh ? INITIAL_INDEX_CAPACITY : (size - sizeof(IndexHeader)) / sizeof(IndexRecord);
+    if (!map_index(capacity)) {
+        return false;
+    }
+    if (fresh) {
+        header()->magic = INDEX_MAGIC;
+        header()->count = 0;
+    } else if (header()->magic != INDEX_MAGIC) {
+        std::cerr << "Block store: " << index_path << " is not a block index!" << std::endl;
+        return false;
+    }
+
+    // Drop index records whose segment data never reached the disk (torn batch before a crash)
+    while (header()->count > 0) {
+        const IndexRecord& last = records()[header()->count - 1];
+        if (file_size(segment_path(last.segment)) >= last.offset + sizeof(uint32_t) + last.length) {
+            break;
+        }
+        header()->count--;
+    }
+
+    active_segment = header()->count > 0 ? records()[header()->count - 1].segment : 0;
+    for (uint32_t segment = 0; segment < active_segment; ++segment) {
+        map_segment(segment);
+    }
+    if (!open_segment(active_segment)) {
+        return false;
+    }
+
+    // Discard any unindexed bytes after the last record so appends stay contiguous
+    if (header()->count > 0) {
+        const IndexRecord& last = records()[header()->count - 1];
+        active_size = last.offset + sizeof(uint32_t) + last.length;
+    } else {
+        active_size = 0;
+    }
+    if (::ftruncate(segment_fd, static_cast<off_t>(active_size)) != 0) {
+        std::cerr << "Block store: cannot trim segment " << active_segment << std::endl;
+        return false;
+    }
+
+    hash_index.clear();
+    hash_index.reserve(header()->count);
+    for (uint64_t height = 0; height < header()->count; ++height) {
+        const IndexRecord& record = records()[height];
+        hash_index[record_hash(record)] = height;
+    }
+    return true;
+}
+
+bool BlockStore::map_index(uint64_t capacity) {
+    size_t bytes = sizeof(IndexHeader) + capacity * sizeof(IndexRecord);
+    if (::ftruncate(index_fd, static_cast<off_t>(bytes)) != 0) {
+        std::cerr << "Block store: cannot size the index file" << std::endl;
+        return false;
+    }
+    void* map = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, index_fd, 0);
+    if (map == MAP_FAILED) {
+        std::cerr << "Block store: cannot map the index file" << std::endl;
+        return false;
+    }
+    index_map = static_cast<uint8_t*>(map);
+    index_capacity = capacity;
+    return true;
+}
+
+// Double the index file and remap it
+bool BlockStore::grow_index() {
+    size_t old_bytes = sizeof(IndexHeader) + index_capacity * sizeof(IndexRecord);
+    ::msync(index_map, old_bytes, MS_SYNC);
+    ::munmap(index_map, old_bytes);
+    index_map = nullptr;
+    return map_index(index_capacity * 2);
+}
+
+bool BlockStore::open_segment(uint32_t segment) {
+    std::string path = segment_path(segment);
+    segment_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (segment_fd < 0) {
+        std::cerr << "Block store: cannot open " << path << std::endl;
+        return false;
+    }
+    active_segment = segment;
+    active_size = file_size(path);
+    return true;
+}
+
+// Map a sealed (no longer appended) segment read-only
+void BlockStore::map_segment(uint32_t segment) {
+    if (sealed_segments.size() <= segment) {
+        sealed_segments.resize(segment + 1);
+    }
+    std::string path = segment_path(segment);
+    size_t size = file_size(path);
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0 || size == 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return;
+    }
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map != MAP_FAILED) {
+        sealed_segments[segment].data = static_cast<const uint8_t*>(map);
+        sealed_segments[segment].size = size;
+    }
+}
+
+void BlockStore::unmap_all() {
+    for (auto& mapping : sealed_segments) {
+        if (mapping.data != nullptr) {
+            ::munmap(const_cast<uint8_t*>(mapping.data), mapping.size);
+        }
+    }
+    sealed_segments.clear();
+    if (index_map != nullptr) {
+        ::munmap(index_map, sizeof(IndexHeader) + index_capacity * sizeof(IndexRecord));
+        index_map = nullptr;
+    }
+}
+
+Hash256 BlockStore::record_hash(const IndexRecord& record) {
+    Hash256 hash;
+    std::memcpy(hash.bytes.data(), record.hash, sizeof(record.hash));
+    return hash;
+}
+
+// Append the block record to the active segment and publish it in the index
+bool BlockStore::append(const Block& block) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index_map == nullptr || segment_fd < 0) {
+        std::cerr << "Block store is not open!" << std::endl;
+        return false;
+    }
+    if (block.index != header()->count) {
+        std::cerr << "Block store: expected height " << header()->count << " but got " << block.index << std::endl;
+        return false;
+    }
+
+    std::string payload = BlockCodec::encode_block(block);
+    uint32_t length = static_cast<uint32_t>(payload.size());
+
+    // Seal the active segment once the record would push it past segment_size
+    if (active_size > 0 && active_size + sizeof(length) + length > options.segment_size) {
+        ::fdatasync(segment_fd);
+        ::close(segment_fd);
+        segment_fd = -1;
+        map_segment(active_segment);
+        if (!open_segment(active_segment + 1)) {
+            return false;
+        }
+    }
+
+    uint64_t offset = active_size;
+    if (!write_all(segment_fd, reinterpret_cast<const char*>(&length), sizeof(length)) ||
+        !write_all(segment_fd, payload.data(), payload.size())) {
+        std::cerr << "Block store: write to segment " << active_segment << " failed" << std::endl;
+        return false;
+    }
+    active_size += sizeof(length) + length;
+
+    if (header()->count == index_capacity && !grow_index()) {
+        return false;
+    }
+    IndexRecord& record = records()[header()->count];
+    std::memset(&record, 0, sizeof(record));
+    record.height = block.index;
+    record.offset = offset;
+    record.segment = active_segment;
+    record.length = length;
+    const Hash256& hash = block.get_block_hash();
+    std::memcpy(record.hash, hash.bytes.data(), sizeof(record.hash));
+    header()->count++;
+    hash_index[hash] = block.index;
+
+    if (++pending_syncs >= options.sync_every) {
+        sync_locked();
+    }
+    return true;
+}
+
+// Shrink the index first so a crash mid-truncate only leaves unindexed bytes, which open() trims
+bool BlockStore::truncate(uint64_t height) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index_map == nullptr || segment_fd < 0) {
+        std::cerr << "Block store is not open!" << std::endl;
+        return false;
+    }
+    if (height >= header()->count) {
+        return true;
+    }
+
+    for (uint64_t dropped = height; dropped < header()->count; ++dropped) {
+        hash_index.erase(record_hash(records()[dropped]));
+    }
+    uint32_t keep_segment = 0;
+    uint64_t keep_size = 0;
+    if (height > 0) {
+        const IndexRecord& last = records()[height - 1];
+        keep_segment = last.segment;
+        keep_size = last.offset + sizeof(uint32_t) + last.length;
+    }
+    header()->count = height;
+    ::msync(index_map, sizeof(IndexHeader) + index_capacity * sizeof(IndexRecord), MS_SYNC);
+
+    // Remove whole segments past the kept tail and reopen the kept segment for appends
+    if (keep_segment != active_segment) {
+        ::close(segment_fd);
+        segment_fd = -1;
+        for (uint32_t segment = keep_segment + 1; segment <= active_segment; ++segment) {
+            ::unlink(segment_path(segment).c_str());
+        }
+        for (uint32_t segment = keep_segment; segment < sealed_segments.size(); ++segment) {
+            SegmentMapping& mapping = sealed_segments[segment];
+            if (mapping.data != nullptr) {
+                ::munmap(const_cast<uint8_t*>(mapping.data), mapping.size);
+            }
+        }
+        if (sealed_segments.size() > keep_segment) {
+            sealed_segments.resize(keep_segment);
+        }
+        if (!open_segment(keep_segment)) {
+            return false;
+        }
+    }
+
+    if (::ftruncate(segment_fd, static_cast<off_t>(keep_size)) != 0) {
+        std::cerr << "Block store: cannot trim segment " << active_segment << std::endl;
+        return false;
+    }
+    active_size = keep_size;
+    sync_locked();
+    return true;
+}
+
+bool BlockStore::read_record(const IndexRecord& record, std::string& out) const {
+    out.resize(record.length);
+    uint64_t offset = record.offset + sizeof(uint32_t);
+    if (record.segment == active_segment) {
+        return ::pread(segment_fd, &out[0], record.length, static_cast<off_t>(offset)) == static_cast<ssize_t>(record.length);
+    }
+    if (record.segment >= sealed_segments.size()) {
+        return false;
+    }
+    const SegmentMapping& mapping = sealed_segments[record.segment];
+    if (mapping.data == nullptr || offset + record.length > mapping.size) {
+        return false;
+    }
+    std::memcpy(&out[0], mapping.data + offset, record.length);
+    return true;
+}
+
+std::shared_ptr<Block> BlockStore::read_block(uint64_t height) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index_map == nullptr || height >= header()->count) {
+        return nullptr;
+    }
+    const IndexRecord& record = records()[height];
+    std::string payload;
+    if (!read_record(record, payload)) {
+        std::cerr << "Block store: cannot read block at height " << height << std::endl;
+        return nullptr;
+    }
+    std::shared_ptr<Block> block = BlockCodec::decode_block(payload);
+    if (!block || block->get_block_hash() != record_hash(record)) {
+        std::cerr << "Block store: block at height " << height << " is corrupt!" << std::endl;
+        return nullptr;
+    }
+    return block;
+}
+
+std::shared_ptr<Block> BlockStore::read_block_by_hash(const Hash256& hash) const {
+    uint64_t height = 0;
+    if (!find_height(hash, height)) {
+        return nullptr;
+    }
+    return read_block(height);
+}
+
+bool BlockStore::find_height(const Hash256& hash, uint64_t& height) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = hash_index.find(hash);
+    if (it == hash_index.end()) {
+        return false;
+    }
+    height = it->second;
+    return true;
+}
+
+bool BlockStore::find_hash(uint64_t height, Hash256& hash) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index_map == nullptr || height >= header()->count) {
+        return false;
+    }
+    hash = record_hash(records()[height]);
+    return true;
+}
+
+uint64_t BlockStore::block_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return index_map != nullptr ? header()->count : 0;
+}
+
+void BlockStore::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    sync_locked();
+}
+
+// Segment data is made durable before the index records that point at it
+void BlockStore::sync_locked() {
+    if (segment_fd >= 0) {
+        ::fdatasync(segment_fd);
+    }
+    if (index_map != nullptr) {
+        ::msync(index_map, sizeof(IndexHeader) + index_capacity * sizeof(IndexRecord), MS_SYNC);
+    }
+    pending_syncs = 0;
+}
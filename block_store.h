@@ -0,0 +1,111 @@
+#ifndef BLOCK_STORE_H
+#define BLOCK_STORE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+#include "hash256.h"
+
+class Block;
+
+// Options for the on-disk block store
+struct BlockStoreOptions {
+    std::string directory;                         // Directory holding segments and the index
+    uint64_t segment_size = 64ull * 1024 * 1024;   // Roll over to a new segment file past this size
+    uint32_t sync_every = 64;                      // fsync after this many appends (1 = every block)
+};
+
+// Append-only, memory-mapped block archive.
+// Blocks are appended to segment files (blk00000.dat, blk00001.dat, ...); a fixed-record
+// index file (index.dat) is mmap'd and maps height -> (segment, offset, length, hash).
+// Reopening a store maps the existing files instead of replaying the chain.
+class BlockStore {
+public:
+    explicit BlockStore(const BlockStoreOptions& options);
+    ~BlockStore();
+
+    BlockStore(const BlockStore&) = delete;
+    BlockStore& operator=(const BlockStore&) = delete;
+
+    // Create or map the store's files; returns false if the directory can't be used
+    bool open();
+
+    // Append the block at height block_count(); syncs every sync_every appends
+    bool append(const Block& block);
+
+    // Drop stored blocks at and above height (a fork switch replaced them); later appends continue from there
+    bool truncate(uint64_t height);
+
+    // Read a stored block back by height or by hash (nullptr if not stored)
+    std::shared_ptr<Block> read_block(uint64_t height) const;
+    std::shared_ptr<Block> read_block_by_hash(const Hash256& hash) const;
+
+    // Height of a stored block by hash (false if not stored)
+    bool find_height(const Hash256& hash, uint64_t& height) const;
+
+    // Hash of the stored block at height, from the index alone (false if not stored)
+    bool find_hash(uint64_t height, Hash256& hash) const;
+
+    // Path of an auxiliary file kept next to the segments (e.g. the ledger checkpoint)
+    std::string file_path(const std::string& name) const { return options.directory + "/" + name; }
+
+    // Number of stored blocks (stored heights are [0, block_count()))
+    uint64_t block_count() const;
+    bool empty() const { return block_count() == 0; }
+
+    // fsync pending segment data, then the index
+    void flush();
+
+private:
+    // Fixed-size index record; the record at position h describes the block at height h
+    struct IndexRecord {
+        uint64_t height;
+        uint64_t offset;       // Offset of the block record inside its segment
+        uint32_t segment;      // Segment file number
+        uint32_t length;       // Length of the encoded block
+        uint8_t hash[32];      // Block hash
+    };
+
+    // Header at the start of the index file
+    struct IndexHeader {
+        uint64_t magic;
+        uint64_t count;        // Number of valid records
+    };
+
+    // Read-only mapping of a sealed segment
+    struct SegmentMapping {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+    };
+
+    std::string segment_path(uint32_t segment) const;
+    bool map_index(uint64_t capacity);
+    bool grow_index();
+    bool open_segment(uint32_t segment);
+    void map_segment(uint32_t segment);
+    void unmap_all();
+    bool read_record(const IndexRecord& record, std::string& out) const;
+    void sync_locked();
+    static Hash256 record_hash(const IndexRecord& record);
+
+    IndexHeader* header() const { return reinterpret_cast<IndexHeader*>(index_map); }
+    IndexRecord* records() const { return reinterpret_cast<IndexRecord*>(index_map + sizeof(IndexHeader)); }
+
+    BlockStoreOptions options;
+    int index_fd;                                 // index.dat
+    uint8_t* index_map;                           // mmap of index.dat
+    uint64_t index_capacity;                      // Records that fit in the current mapping
+    int segment_fd;                               // Active segment, opened for append
+    uint32_t active_segment;                      // Number of the active segment
+    uint64_t active_size;                         // Bytes written to the active segment
+    std::vector<SegmentMapping> sealed_segments;  // Read-only maps of earlier segments
+    std::unordered_map<Hash256, uint64_t, Hash256Hasher> hash_index;  // Block hash -> height
+    uint32_t pending_syncs;                       // Appends since the last fsync
+    mutable std::mutex mutex;
+};
+
+#endif // BLOCK_STORE_H
@@ -8,148 +8,628 @@
 #include <unordered_map>
 #include <memory>
 #include <ctime>
-
-// Forward declaration of Transaction class for the blockchain
-class Transaction;
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <future>
+#include <thread>
+#include <functional>
+#include "hash256.h"
+#include "transaction.h"
+#include "transaction_arena.h"
+#include "merkle.h"
+#include "block_ring.h"
+#include "block_store.h"
+#include "thread_pool.h"
+#include "chain_index.h"
+#include "ledger_state.h"
+#include "fork_tree.h"
 
 // Structure for Block to hold data and metadata
 class Block {
 public:
     uint64_t index;                  // Block index in the chain
-    std::string previous_hash;       // Hash of the previous block
-    std::string block_hash;          // Hash of the current block
+    Hash256 previous_hash;           // Hash of the previous block
+    Hash256 block_hash;              // Hash of the current block
     uint64_t timestamp;              // Time the block was created
-    std::vector<std::shared_ptr<Transaction>> transactions;  // List of transactions in the block
+    TransactionArena transactions;   // Transactions in the block, stored contiguously in their encoding
+    Hash256 merkle_root;             // Merkle root over the transaction digests
     std::string block_proposer;      // The node that proposed this block
     bool is_valid;                   // Validation status of the block (part of BFT)
+    uint64_t encoded_size;           // Exact size of the block's binary encoding (see block_codec.h)
+    bool merkle_mutated;             // The transaction list duplicates its tail to hit the root (see merkle.h)
     
-    // Constructor for Block
-    Block(uint64_t idx, std::string prev_hash, std::vector<std::shared_ptr<Transaction>> txns, std::string proposer) :
-        index(idx), previous_hash(prev_hash), timestamp(std::time(nullptr)), transactions(txns), block_proposer(proposer), is_valid(true) {
-            this->block_hash = compute_hash();
+    // Constructor for Block (takes ownership of an already filled arena)
+    Block(uint64_t idx, const Hash256& prev_hash, TransactionArena txns, std::string proposer) :
+        index(idx), previous_hash(prev_hash), timestamp(std::time(nullptr)), transactions(std::move(txns)), block_proposer(proposer), is_valid(true) {
+            finalize();
+        }
+
+    // Constructor for Block from individual transactions (encoded into the block's arena)
+    Block(uint64_t idx, const Hash256& prev_hash, const std::vector<std::shared_ptr<Transaction>>& txns, std::string proposer) :
+        index(idx), previous_hash(prev_hash), timestamp(std::time(nullptr)), transactions(make_arena(txns)), block_proposer(proposer), is_valid(true) {
+            finalize();
         }
 
-    // Function to calculate the block's hash based on its data
-    std::string compute_hash() {
-        std::string data = std::to_string(index) + previous_hash + std::to_string(timestamp) + block_proposer;
-        for (const auto& txn : transactions) {
-            data += txn->get_transaction_data();
+    // Constructor for restoring a stored Block (keeps the original timestamp)
+    Block(uint64_t idx, const Hash256& prev_hash, uint64_t ts, TransactionArena txns, std::string proposer) :
+        index(idx), previous_hash(prev_hash), timestamp(ts), transactions(std::move(txns)), block_proposer(proposer), is_valid(true) {
+            finalize();
+        }
+
+    // Encode transactions into a new arena sized in one allocation
+    static TransactionArena make_arena(const std::vector<std::shared_ptr<Transaction>>& txns) {
+        size_t byte_count = 0;
+        for (const auto& txn : txns) {
+            byte_count += txn->get_encoded_size();
+        }
+        TransactionArena arena;
+        arena.reserve(txns.size(), byte_count);
+        for (const auto& txn : txns) {
+            arena.append(*txn);
         }
-        return std::to_string(std::hash<std::string>{}(data));
+        return arena;
     }
 
-    // Get the block hash
-    std::string get_block_hash() const {
-        return block_hash;
+    // Compute the derived header fields once the transactions are in place
+    void finalize() {
+        this->merkle_root = Merkle::compute_root(get_transaction_digests(), &this->merkle_mutated);
+        this->block_hash = compute_hash();
+        this->encoded_size = compute_encoded_size();
     }
-};
 
-// Transaction class for representing a transaction in the blockchain
-class Transaction {
-public:
-    std::string sender;
-    std::string receiver;
-    double amount;
-    uint64_t timestamp;  // Timestamp for when the transaction was created
-    std::string snark_proof;  // Placeholder for SNARK proof
+    // Function to calculate the block's hash from its encoded header (commits to transactions via merkle_root)
+    Hash256 compute_hash() const {
+        return Hash256::digest(BlockCodec::encode_header(*this));
+    }
+
+    // Size of the block's binary encoding (the arena already holds the encoded transactions)
+    uint64_t compute_encoded_size() const {
+        return BlockCodec::encoded_header_size(*this) + BlockCodec::varint_size(transactions.size()) + transactions.byte_size();
+    }
+
+    // Cached digests of the block's transactions (Merkle leaves)
+    const std::vector<Hash256>& get_transaction_digests() const {
+        return transactions.get_digests();
+    }
+
+    // Function to calculate the Merkle root over the cached transaction digests
+    Hash256 compute_merkle_root() const {
+        return Merkle::compute_root(get_transaction_digests());
+    }
+
+    // Full body check: every digest matches its transaction and the root matches the digests
+    // (a transaction list that only collides with the root by duplicating its tail is rejected)
+    bool verify_transactions() const {
+        for (size_t i = 0; i < transactions.size(); i++) {
+            if (transactions.digest(i) != TransactionArena::compute_digest(transactions.encoded(i))) {
+                return false;
+            }
+        }
+        bool mutated = false;
+        return merkle_root == Merkle::compute_root(get_transaction_digests(), &mutated) && !mutated;
+    }
 
-    Transaction(std::string s, std::string r, double amt, std::string proof)
-        : sender(s), receiver(r), amount(amt), timestamp(std::time(nullptr)), snark_proof(proof) {}
+    // Build the inclusion proof for the transaction at the given position
+    std::vector<Merkle::ProofStep> get_merkle_proof(size_t position) const {
+        return Merkle::build_proof(get_transaction_digests(), position);
+    }
 
-    // Function to get the transaction data (used for block hash computation)
-    std::string get_transaction_data() const {
-        return sender + receiver + std::to_string(amount) + std::to_string(timestamp);
+    // Get the block hash
+    const Hash256& get_block_hash() const {
+        return block_hash;
     }
 };
 
+// Ledger checkpoint file kept in the block store's directory
+const char* const LEDGER_CHECKPOINT_FILE = "ledger.dat";
+
 // Blockchain class to represent the chain and its operations
 class Blockchain {
 public:
     uint64_t difficulty;  // Difficulty level for block hash (e.g., PoW)
     uint64_t max_block_size;  // Max size for a block (in bytes)
-    uint64_t max_chain_size;  // Max number of blocks the blockchain can hold
+    uint64_t max_chain_size;  // Max number of blocks the blockchain can hold (at least the tip and its successor)
+    uint64_t prune_batch_size;  // Number of oldest blocks evicted at once when the chain is full
 
-    std::vector<std::shared_ptr<Block>> chain;   // The blockchain (list of blocks)
-    std::unordered_map<std::string, std::shared_ptr<Block>> block_map;  // Map for quick lookup of blocks by hash
+    BlockRing chain;   // The blockchain (fixed-size ring of blocks indexed by height)
+    std::unordered_map<Hash256, uint64_t, Hash256Hasher> block_heights;  // Height of each held block by hash (the ring owns the block)
+    std::shared_ptr<BlockStore> store;  // Optional on-disk archive (keeps pruned blocks)
+    uint64_t checkpoint_interval;  // Save a ledger checkpoint next to the store every this many pruned blocks
+    uint64_t checkpoint_height;  // Height of the last saved ledger checkpoint
+    ChainIndex chain_index;  // tx-id and address indexes over the held blocks
+    LedgerState ledger;  // Account balances as of the latest block, with undo records for held blocks
+    bool enforce_balances;  // Reject blocks whose transfers overdraw a sender
+    uint64_t validated_height;  // Every held block up to this height has passed validation
+    size_t validation_threads;  // Worker count used to validate long ranges of blocks
+    std::shared_ptr<ThreadPool> validation_pool;  // Created on the first parallel validation
+    std::function<std::shared_ptr<Block>(uint64_t)> cold_loader;  // Loads held blocks whose ring slot was released
+    std::function<void()> on_blocks_connected;  // Called after add_block() connects blocks (e.g. to track them for compaction)
 
     // Constructor for the Blockchain, sets up the genesis block
-    Blockchain(uint64_t max_size = 1024 * 1024 * 1, uint64_t max_chain = 1000)
-        : max_block_size(max_size), max_chain_size(max_chain), difficulty(1) {
+    Blockchain(uint64_t max_size = 1024 * 1024 * 1, uint64_t max_chain = 1000, uint64_t prune_batch = 1)
+        : difficulty(1), max_block_size(max_size), max_chain_size(std::max<uint64_t>(2, max_chain)), prune_batch_size(prune_batch),
+          chain(max_chain_size), checkpoint_interval(1024), checkpoint_height(0), enforce_balances(false), validated_height(0),
+          validation_threads(std::max(1u, std::thread::hardware_concurrency())) {
         // Initialize the blockchain with a genesis block
         std::shared_ptr<Block> genesis = create_genesis_block();
         chain.push_back(genesis);
-        block_map[genesis->get_block_hash()] = genesis;
+        block_heights[genesis->get_block_hash()] = genesis->index;
+        chain_index.add_block(*genesis);
+        ledger.apply_block(*genesis);
     }
 
     // Create and return the Genesis block
     std::shared_ptr<Block> create_genesis_block() {
         std::vector<std::shared_ptr<Transaction>> empty_transactions;
-        return std::make_shared<Block>(0, "0", empty_transactions, "genesis_proposer");
+        return std::make_shared<Block>(0, Hash256{}, empty_transactions, "genesis_proposer");
     }
 
-    // Add a new block to the chain
+    // Add a new block. A block extending the tip is connected; a block whose parent is unknown waits
+    // in the orphan pool; a block extending another branch goes to the fork tree, and the chain
+    // switches to that branch once it is longer. Returns false if the block is rejected.
     bool add_block(std::shared_ptr<Block> block) {
-        if (block->index != chain.size()) {
-            std::cerr << "Invalid block index!" << std::endl;
+        const Hash256& hash = block->get_block_hash();
+        if (block_heights.count(hash) || fork_tree.contains(hash) || orphans.contains(hash)) {
+            std::cerr << "Block already known!" << std::endl;
             return false;
         }
 
-        // Check if the block size exceeds the maximum limit
-        uint64_t block_size = sizeof(*block);
-        for (const auto& txn : block->transactions) {
-            block_size += sizeof(*txn);
+        // Validate the header hash before buffering anything
+        if (hash != block->compute_hash()) {
+            std::cerr << "Invalid block hash!" << std::endl;
+            return false;
         }
 
-        if (block_size > max_block_size) {
+        if (block->merkle_mutated) {
+            std::cerr << "Block has a mutated transaction list!" << std::endl;
+            return false;
+        }
+
+        // Check if the block's encoded size exceeds the maximum limit
+        if (block->encoded_size > max_block_size) {
             std::cerr << "Block size exceeds maximum allowed size!" << std::endl;
             return false;
         }
 
-        // Check if the chain has exceeded its size limit
-        if (chain.size() > max_chain_size) {
-            std::cerr << "Blockchain exceeded maximum allowed size!" << std::endl;
-            prune_blockchain();
+        if (block->previous_hash == get_latest_block()->get_block_hash()) {
+            if (!connect_block(block)) {
+                return false;
+            }
+        } else if (std::shared_ptr<Block> parent = find_branch_parent(*block)) {
+            if (block->index != parent->index + 1) {
+                std::cerr << "Invalid block index!" << std::endl;
+                return false;
+            }
+            if (!fork_tree.add(block)) {
+                std::cerr << "Side branch budget exhausted!" << std::endl;
+                return false;
+            }
+        } else {
+            // Its parent was pruned or it claims a height the chain has finalized
+            if (block->index <= chain.first_height()) {
+                std::cerr << "Block forks below the held chain!" << std::endl;
+                return false;
+            }
+            return orphans.add(block);
         }
 
-        // Add the block to the blockchain
-        chain.push_back(block);
-        block_map[block->get_block_hash()] = block;
+        connect_orphans(hash);
+        choose_fork();
+        if (on_blocks_connected) {
+            on_blocks_connected();
+        }
+        return true;
+    }
+
+    // Attach an opened block store. An empty store is seeded with the held blocks; otherwise the
+    // chain resumes from the stored tip by mapping only its last blocks, and the ledger is loaded
+    // from the checkpoint kept next to the store (only blocks after it are applied).
+    bool attach_store(std::shared_ptr<BlockStore> block_store) {
+        store = block_store;
+        if (store->empty()) {
+            for (uint64_t height = chain.first_height(); height < chain.next_height(); height++) {
+                std::shared_ptr<Block> block = get_block(height);
+                if (!block || !store->append(*block)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        uint64_t stored = store->block_count();
+        uint64_t first = stored > chain.capacity() ? stored - chain.capacity() : 0;
+        chain.reset(first);
+        block_heights.clear();
+        chain_index = ChainIndex();
+        ledger = LedgerState();
+
+        // Balances as of the block before the held range: from the checkpoint when it is on this
+        // chain and not past that block, otherwise by replaying from genesis
+        uint64_t replay_from = 0;
+        uint64_t saved_height = 0;
+        Hash256 saved_hash;
+        Hash256 stored_hash;
+        if (first > 0 && ledger.load_checkpoint(store->file_path(LEDGER_CHECKPOINT_FILE), saved_height, saved_hash)) {
+            if (saved_height < first && store->find_hash(saved_height, stored_hash) && stored_hash == saved_hash) {
+                replay_from = saved_height + 1;
+                checkpoint_height = saved_height;
+            } else {
+                ledger = LedgerState();
+            }
+        }
+
+        // Blocks below the held range are final, so no undo is kept
+        for (uint64_t height = replay_from; height < first; height++) {
+            std::shared_ptr<Block> block = store->read_block(height);
+            if (!block) {
+                std::cerr << "Failed to load block " << height << " from the block store!" << std::endl;
+                return false;
+            }
+            ledger.apply_block(*block);
+            ledger.discard_undo(height);
+        }
+        validated_height = first;  // Loaded blocks are re-linked by the next validate_blockchain()
+        for (uint64_t height = first; height < stored; height++) {
+            std::shared_ptr<Block> block = store->read_block(height);
+            if (!block) {
+                std::cerr << "Failed to load block " << height << " from the block store!" << std::endl;
+                return false;
+            }
+            chain.push_back(block);
+            block_heights[block->get_block_hash()] = block->index;
+            chain_index.add_block(*block);
+            ledger.apply_block(*block);
+        }
+        return true;
+    }
+
+    // Save the ledger as of the block just below the held chain next to the store, so the next
+    // attach_store() starts from it instead of replaying the archive
+    bool save_ledger_checkpoint() {
+        if (!store || chain.first_height() == 0) {
+            return false;
+        }
+        uint64_t height = chain.first_height() - 1;
+        Hash256 hash;
+        if (!store->find_hash(height, hash)) {
+            return false;
+        }
+        store->flush();
+        if (!ledger.save_checkpoint(store->file_path(LEDGER_CHECKPOINT_FILE), height, hash)) {
+            std::cerr << "Failed to save the ledger checkpoint at height " << height << "!" << std::endl;
+            return false;
+        }
+        checkpoint_height = height;
+        return true;
+    }
+
+    // Look up a block by height: released ring slots go through cold_loader, and pruned (or
+    // spilled) blocks fall back to the archive
+    std::shared_ptr<Block> get_block(uint64_t height) const {
+        if (chain.contains(height)) {
+            if (const std::shared_ptr<Block>& block = chain[height]) {
+                return block;
+            }
+            if (cold_loader) {
+                if (std::shared_ptr<Block> block = cold_loader(height)) {
+                    return block;
+                }
+            }
+        }
+        return store ? store->read_block(height) : nullptr;
+    }
+
+    // Drop the ring's reference to a held block that has a compacted copy, so the copy can be
+    // the only one in memory; later reads go through get_block(). The tip is always kept.
+    bool release_block(uint64_t height, const Hash256& hash) {
+        if (!cold_loader || !chain.contains(height) || height + 1 >= chain.next_height() || !chain[height] ||
+            chain[height]->get_block_hash() != hash) {
+            return false;
+        }
+        chain.release(height);
         return true;
     }
 
     // Function to get the latest block
     std::shared_ptr<Block> get_latest_block() const {
-        return chain.back();
+        const std::shared_ptr<Block>& tip = chain.back();
+        return tip ? tip : get_block(chain.next_height() - 1);  // Released below a disconnected tip
+    }
+
+    // Balance of an address as of the latest block; O(1)
+    double get_balance(const std::string& address) const {
+        return ledger.get_balance(address);
+    }
+
+    // Find a held transaction by its id (digest); O(1)
+    bool find_transaction(const Hash256& tx_id, TxLocation& location) const {
+        return chain_index.find_transaction(tx_id, location);
+    }
+
+    // Heights of the held blocks in which the address sent or received, oldest first; O(k)
+    std::vector<uint64_t> get_address_history(const std::string& address) const {
+        const std::deque<uint64_t>* heights = chain_index.address_heights(address);
+        return heights ? std::vector<uint64_t>(heights->begin(), heights->end()) : std::vector<uint64_t>();
     }
 
-    // Function to prune the blockchain (remove the oldest block)
+    // Number of blocks waiting for their parent / held on side branches
+    size_t orphan_count() const { return orphans.size(); }
+    size_t side_block_count() const { return fork_tree.size(); }
+
+    // Function to prune the blockchain (evict the oldest prune_batch_size blocks once full)
     void prune_blockchain() {
-        if (chain.size() > max_chain_size) {
-            // Remove the oldest block from the blockchain
-            std::shared_ptr<Block> block_to_remove = chain.front();
-            chain.erase(chain.begin());
-            block_map.erase(block_to_remove->get_block_hash());
+        if (!chain.full()) {
+            return;
+        }
+        // Always keep the latest block so the next block still links to it (the ring holds at least two)
+        uint64_t evict_count = std::min<uint64_t>(std::max<uint64_t>(1, prune_batch_size), chain.size() - 1);
+        for (uint64_t i = 0; i < evict_count && !chain.empty(); i++) {
+            std::shared_ptr<Block> block_to_remove = get_block(chain.first_height());
+            chain.pop_front();
+            if (!block_to_remove) {
+                std::cerr << "Released block " << chain.first_height() - 1 << " could not be reloaded!" << std::endl;
+                continue;
+            }
+            block_heights.erase(block_to_remove->get_block_hash());
+            chain_index.remove_block(*block_to_remove);
+            ledger.discard_undo(block_to_remove->index);
+        }
+
+        // Branches forking below the held chain can never be switched to
+        fork_tree.prune_below(chain.first_height());
+        orphans.prune_below(chain.first_height());
+
+        if (store && chain.first_height() - 1 >= checkpoint_height + checkpoint_interval) {
+            save_ledger_checkpoint();
         }
     }
 
-    // Function to validate the blockchain
+    // Function to validate the blockchain (only blocks above the validated_height watermark)
     bool validate_blockchain() {
-        for (size_t i = 1; i < chain.size(); i++) {
-            std::shared_ptr<Block> current_block = chain[i];
-            std::shared_ptr<Block> previous_block = chain[i - 1];
+        uint64_t start = std::max(validated_height, chain.first_height()) + 1;
+        if (!validate_range(start, chain.next_height())) {
+            return false;
+        }
+        validated_height = chain.next_height() - 1;
+        return true;
+    }
 
-            // Check the hash of the current block to ensure it matches
-            if (current_block->previous_hash != previous_block->get_block_hash()) {
-                std::cerr << "Blockchain validation failed: invalid previous hash!" << std::endl;
-                return false;
+    // Full audit of every held block, ignoring the watermark
+    bool audit_blockchain() {
+        validated_height = chain.first_height();
+        return validate_blockchain();
+    }
+
+    // Check one block's hash and its link to the previous block; returns the failure reason or nullptr
+    const char* check_block(uint64_t height) const {
+        std::shared_ptr<Block> current_block = get_block(height);
+        std::shared_ptr<Block> previous_block = get_block(height - 1);
+        if (!current_block || !previous_block) {
+            return "block unavailable";
+        }
+
+        // Check the hash of the current block to ensure it matches
+        if (current_block->previous_hash != previous_block->get_block_hash()) {
+            return "invalid previous hash";
+        }
+
+        // Validate the block hash matches (header only, O(1) per block)
+        if (current_block->get_block_hash() != current_block->compute_hash()) {
+            return "invalid block hash";
+        }
+        return nullptr;
+    }
+
+    // Validate heights [start, end). Large ranges are split across the validation pool; every
+    // range checks the link into its first block, so range boundaries are covered, and all
+    // ranges stop as soon as any of them finds a failure.
+    bool validate_range(uint64_t start, uint64_t end) {
+        if (start >= end) {
+            return true;
+        }
+
+        const uint64_t MIN_BLOCKS_PER_TASK = 256;
+        uint64_t block_count = end - start;
+        uint64_t task_count = std::min<uint64_t>(validation_threads, block_count / MIN_BLOCKS_PER_TASK);
+        if (task_count <= 1) {
+            for (uint64_t height = start; height < end; height++) {
+                if (const char* reason = check_block(height)) {
+                    std::cerr << "Blockchain validation failed: " << reason << " at height " << height << "!" << std::endl;
+                    return false;
+                }
             }
+            return true;
+        }
 
-            // Validate the block hash matches
-            if (current_block->get_block_hash() != current_block->compute_hash()) {
-                std::cerr << "Blockchain validation failed: invalid block hash!" << std::endl;
-                return false;
+        if (!validation_pool) {
+            validation_pool = std::make_shared<ThreadPool>(validation_threads);
+        }
+
+        // Lowest failure so far, height and reason recorded together. A worker only stops once it
+        // passes that height, so ranges below a failure are still checked to the end.
+        std::mutex failure_mutex;
+        uint64_t failed_height = end;
+        const char* failed_reason = nullptr;
+        std::atomic<uint64_t> stop_height(end);
+        std::vector<std::future<void>> tasks;
+        uint64_t range_size = (block_count + task_count - 1) / task_count;
+        for (uint64_t range_start = start; range_start < end; range_start += range_size) {
+            uint64_t range_end = std::min(end, range_start + range_size);
+            tasks.push_back(validation_pool->submit([&, range_start, range_end] {
+                for (uint64_t height = range_start; height < range_end && height < stop_height.load(std::memory_order_relaxed); height++) {
+                    if (const char* reason = check_block(height)) {
+                        std::lock_guard<std::mutex> lock(failure_mutex);
+                        if (height < failed_height) {
+                            failed_height = height;
+                            failed_reason = reason;
+                            stop_height.store(height, std::memory_order_relaxed);
+                        }
+                        return;
+                    }
+                }
+            }));
+        }
+        for (auto& task : tasks) {
+            task.get();
+        }
+
+        if (failed_reason != nullptr) {
+            std::cerr << "Blockchain validation failed: " << failed_reason << " at height " << failed_height << "!" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    ForkTree fork_tree;  // Side-branch blocks that link into the held chain
+    OrphanPool orphans;  // Blocks whose parent hasn't arrived yet
+
+    // Append a block on top of the current tip and apply it to the indexes, ledger and store.
+    // Balance checks are skipped when restoring blocks that were already connected once.
+    bool connect_block(const std::shared_ptr<Block>& block, bool check_balances = true) {
+        if (block->index != chain.next_height()) {
+            std::cerr << "Invalid block index!" << std::endl;
+            return false;
+        }
+
+        // Check balances against the materialized ledger (no chain replay)
+        if (check_balances && enforce_balances && !ledger.can_apply(*block)) {
+            std::cerr << "Block overdraws an account!" << std::endl;
+            return false;
+        }
+
+        // Make room if the chain has reached its size limit
+        if (chain.full()) {
+            prune_blockchain();
+        }
+
+        // Add the block to the blockchain
+        chain.push_back(block);
+        block_heights[block->get_block_hash()] = block->index;
+        chain_index.add_block(*block);
+        ledger.apply_block(*block);
+
+        // Archive the block on disk
+        if (store && !store->append(*block)) {
+            std::cerr << "Failed to persist block " << block->index << "!" << std::endl;
+        }
+        return true;
+    }
+
+    // Remove the tip block from the ring, indexes and ledger (the store is truncated by the caller)
+    std::shared_ptr<Block> disconnect_tip() {
+        std::shared_ptr<Block> block = get_block(chain.next_height() - 1);
+        chain.pop_back();
+        block_heights.erase(block->get_block_hash());
+        chain_index.remove_block(*block);
+        ledger.undo_block(block->index);
+        return block;
+    }
+
+    // Parent of a non-tip block on the held chain or a side branch (nullptr if unknown)
+    std::shared_ptr<Block> find_branch_parent(const Block& block) const {
+        auto it = block_heights.find(block.previous_hash);
+        if (it != block_heights.end()) {
+            return get_block(it->second);
+        }
+        return fork_tree.get(block.previous_hash);
+    }
+
+    // Pull in orphans that descend from a newly known block, breadth first
+    void connect_orphans(const Hash256& parent_hash) {
+        std::queue<Hash256> parents;
+        parents.push(parent_hash);
+        while (!parents.empty()) {
+            for (auto& child : orphans.take_children(parents.front())) {
+                bool accepted = false;
+                if (child->previous_hash == get_latest_block()->get_block_hash()) {
+                    accepted = connect_block(child);
+                } else if (std::shared_ptr<Block> parent = find_branch_parent(*child)) {
+                    if (child->index == parent->index + 1) {
+                        accepted = fork_tree.add(child);
+                    }
+                }
+                if (accepted) {
+                    parents.push(child->get_block_hash());
+                }
+            }
+            parents.pop();
+        }
+    }
+
+    // Longest chain wins: switch to the best side branch while it is higher than the tip
+    void choose_fork() {
+        while (std::shared_ptr<Block> best = fork_tree.best_tip()) {
+            if (best->index <= get_latest_block()->index || reorganize(best)) {
+                return;
             }
         }
+    }
+
+    // Switch the chain to the branch ending at new_tip. Only the divergent suffix is touched:
+    // main-chain blocks above the fork point are unapplied (and kept in the fork tree so the
+    // chain can switch back), then the branch blocks are connected. If a branch block fails,
+    // it and its descendants are dropped and the original chain is restored.
+    bool reorganize(const std::shared_ptr<Block>& new_tip) {
+        // Walk back through the fork tree to the fork point on the held chain
+        std::vector<std::shared_ptr<Block>> branch;
+        for (std::shared_ptr<Block> cursor = new_tip; cursor; cursor = fork_tree.get(cursor->previous_hash)) {
+            branch.push_back(cursor);
+            if (block_heights.count(cursor->previous_hash)) {
+                break;
+            }
+        }
+        // Give up on branches that no longer link into the held chain, or that are so long the
+        // fork point could be pruned while they are connected
+        if (!block_heights.count(branch.back()->previous_hash) || branch.size() >= chain.capacity()) {
+            for (const auto& block : branch) {
+                fork_tree.remove(block->get_block_hash());
+            }
+            return false;
+        }
+        std::reverse(branch.begin(), branch.end());
+        uint64_t fork_height = branch.front()->index - 1;
+
+        // Unapply the main chain down to the fork point
+        std::vector<std::shared_ptr<Block>> detached;
+        while (get_latest_block()->index > fork_height) {
+            detached.push_back(disconnect_tip());
+        }
+        if (store) {
+            store->truncate(fork_height + 1);
+        }
+        validated_height = std::min(validated_height, fork_height);
+
+        size_t connected = 0;
+        for (; connected < branch.size(); connected++) {
+            fork_tree.remove(branch[connected]->get_block_hash());
+            if (!connect_block(branch[connected])) {
+                break;
+            }
+        }
+
+        if (connected < branch.size()) {
+            std::cerr << "Fork switch aborted: block " << branch[connected]->index << " is invalid!" << std::endl;
+            for (size_t i = connected + 1; i < branch.size(); i++) {
+                fork_tree.remove(branch[i]->get_block_hash());
+            }
+            // Put the valid part of the branch back on the side and restore the original chain
+            while (get_latest_block()->index > fork_height) {
+                fork_tree.add(disconnect_tip());
+            }
+            if (store) {
+                store->truncate(fork_height + 1);
+            }
+            for (auto it = detached.rbegin(); it != detached.rend(); ++it) {
+                connect_block(*it, false);
+            }
+            return false;
+        }
+
+        for (auto& block : detached) {
+            fork_tree.add(std::move(block));
+        }
         return true;
     }
 };
@@ -0,0 +1,92 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+// Fixed-capacity multi-producer / multi-consumer queue. A full queue makes push() wait and
+// try_push() fail, which is how a slow consumer pushes back on its producers. Once closed,
+// pushes fail and consumers drain what is left.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity == 0 ? 1 : capacity), closed(false) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Enqueue without waiting; false if the queue is full or closed (item is left untouched)
+    bool try_push(T& item) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (closed || items.size() >= capacity) {
+                return false;
+            }
+            items.push_back(std::move(item));
+        }
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Enqueue, waiting while the queue is full; false if it was closed
+    bool push(T item) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+            if (closed) {
+                return false;
+            }
+            items.push_back(std::move(item));
+        }
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Move up to max_items into out, waiting until at least one is available; returns the
+    // number taken (0 only once the queue is closed and drained)
+    size_t pop_batch(std::vector<T>& out, size_t max_items) {
+        size_t taken = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_empty.wait(lock, [this] { return closed || !items.empty(); });
+            while (taken < max_items && !items.empty()) {
+                out.push_back(std::move(items.front()));
+                items.pop_front();
+                taken++;
+            }
+        }
+        if (taken > 0) {
+            not_full.notify_all();
+        }
+        return taken;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+
+    size_t get_capacity() const { return capacity; }
+
+private:
+    const size_t capacity;
+    mutable std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<T> items;
+    bool closed;
+};
+
+#endif // BOUNDED_QUEUE_H
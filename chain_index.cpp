@@ -0,0 +1,64 @@
+#include "chain_index.h"
+#include "blockchain.h"
+
+void ChainIndex::add_block(const Block& block) {
+    for (size_t position = 0; position < block.transactions.size(); ++position) {
+        BlockCodec::TransactionView tx = block.transactions[position];
+        tx_index[block.transactions.digest(position)] = TxLocation{block.index, static_cast<uint32_t>(position)};
+        add_posting(std::string(tx.sender), block.index);
+        add_posting(std::string(tx.receiver), block.index);
+    }
+}
+
+void ChainIndex::remove_block(const Block& block) {
+    for (size_t position = 0; position < block.transactions.size(); ++position) {
+        BlockCodec::TransactionView tx = block.transactions[position];
+
+        // Only erase the id if it still points at this block (the same id may be re-included later)
+        auto it = tx_index.find(block.transactions.digest(position));
+        if (it != tx_index.end() && it->second.height == block.index) {
+            tx_index.erase(it);
+        }
+        remove_posting(std::string(tx.sender), block.index);
+        remove_posting(std::string(tx.receiver), block.index);
+    }
+}
+
+bool ChainIndex::find_transaction(const Hash256& tx_id, TxLocation& location) const {
+    auto it = tx_index.find(tx_id);
+    if (it == tx_index.end()) {
+        return false;
+    }
+    location = it->second;
+    return true;
+}
+
+const std::deque<uint64_t>* ChainIndex::address_heights(const std::string& address) const {
+    auto it = address_index.find(address);
+    return it == address_index.end() ? nullptr : &it->second;
+}
+
+// Postings stay sorted and unique because blocks are indexed in height order
+void ChainIndex::add_posting(const std::string& address, uint64_t height) {
+    std::deque<uint64_t>& heights = address_index[address];
+    if (heights.empty() || heights.back() != height) {
+        heights.push_back(height);
+    }
+}
+
+// Blocks leave from either end of the chain, so the height is at one end of the posting list
+void ChainIndex::remove_posting(const std::string& address, uint64_t height) {
+    auto it = address_index.find(address);
+    if (it == address_index.end()) {
+        return;
+    }
+    std::deque<uint64_t>& heights = it->second;
+    if (!heights.empty() && heights.front() == height) {
+        heights.pop_front();
+    } else if (!heights.empty() && heights.back() == height) {
+        heights.pop_back();
+    }
+    if (heights.empty()) {
+        address_index.erase(it);
+    }
+}
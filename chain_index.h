@@ -0,0 +1,45 @@
+#ifndef CHAIN_INDEX_H
+#define CHAIN_INDEX_H
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include "hash256.h"
+
+class Block;
+
+// Where a transaction sits in the chain
+struct TxLocation {
+    uint64_t height;     // Height of the block holding the transaction
+    uint32_t position;   // Position of the transaction inside the block
+};
+
+// Secondary indexes over the held blocks, maintained incrementally as blocks are added and
+// trimmed: tx-id -> location, and address -> ascending list of heights it appears in.
+class ChainIndex {
+public:
+    // Index every transaction of a newly added block (heights must be added in ascending order)
+    void add_block(const Block& block);
+
+    // Drop a block's entries; works for the oldest block (pruning) and the newest one (undo)
+    void remove_block(const Block& block);
+
+    // Look up a transaction by its id (digest)
+    bool find_transaction(const Hash256& tx_id, TxLocation& location) const;
+
+    // Heights of the blocks in which the address sent or received (nullptr if none are held)
+    const std::deque<uint64_t>* address_heights(const std::string& address) const;
+
+    size_t transaction_count() const { return tx_index.size(); }
+    size_t address_count() const { return address_index.size(); }
+
+private:
+    void add_posting(const std::string& address, uint64_t height);
+    void remove_posting(const std::string& address, uint64_t height);
+
+    std::unordered_map<Hash256, TxLocation, Hash256Hasher> tx_index;      // tx-id -> location
+    std::unordered_map<std::string, std::deque<uint64_t>> address_index;  // address -> heights
+};
+
+#endif // CHAIN_INDEX_H
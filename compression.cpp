@@ -1,65 +1,669 @@
 #include "compression.h"
+#include "block_columns.h"
+#include "block_archive.h"
 #include <iostream>
 #include <vector>
 #include <zlib.h>  // For compression and decompression
 #include <stdexcept>
 #include <assert.h>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <climits>
+#include <cmath>
 
 // Compression using zlib (you can replace this with more advanced algorithms for real-world use)
 namespace Compcrypt {
 
-// Compress data using zlib (for simplicity, but can be replaced with more advanced techniques)
-std::vector<uint8_t> compress(const std::vector<uint8_t>& inputData) {
-    uLongf compressedSize = compressBound(inputData.size());
-    std::vector<uint8_t> compressedData(compressedSize);
+namespace {
+
+// zlib counts in uInt, so large inputs are fed in pieces of at most this size
+const size_t MAX_ZLIB_CHUNK = 1u << 30;
+
+// Output grows by at least this much per deflate call
+const size_t MIN_OUTPUT_CHUNK = 16 * 1024;
 
-    int result = compress(compressedData.data(), &compressedSize, inputData.data(), inputData.size());
-    if (result != Z_OK) {
-        throw std::runtime_error("Compression failed!");
+// Deflate cannot expand its input by more than this (a 258-byte match costs at least two bits)
+const uint64_t MAX_INFLATION_RATIO = 1032;
+
+void put_u32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
     }
+}
 
-    compressedData.resize(compressedSize);  // Resize to actual compressed data size
-    return compressedData;
+void put_u64(uint8_t* out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
 }
 
-// Decompress data using zlib
-std::vector<uint8_t> decompress(const std::vector<uint8_t>& compressedData) {
-    uLongf decompressedSize = compressedData.size() * 10;  // Initial guess (can be optimized)
-    std::vector<uint8_t> decompressedData(decompressedSize);
+uint32_t get_u32(const uint8_t* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+uint64_t get_u64(const uint8_t* in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+} // namespace
+
+bool parse_frame_header(std::string_view frame, FrameHeader& header) {
+    if (frame.size() < FRAME_HEADER_SIZE) {
+        return false;
+    }
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(frame.data());
+    if (get_u32(bytes) != FRAME_MAGIC) {
+        return false;
+    }
+    header.raw_length = get_u64(bytes + 4);
+    header.payload_length = get_u32(bytes + 12);
+    header.dictionary_id = get_u32(bytes + 16);
+    header.codec = static_cast<Codec>(bytes[20]);
+    header.transform = static_cast<Transform>(bytes[21]);
+    if (frame.size() - FRAME_HEADER_SIZE < header.payload_length) {
+        return false;
+    }
+    // raw_length sizes the decoder's output, so it must be plausible before anything is allocated
+    if (header.raw_length > MAX_ZLIB_CHUNK) {
+        return false;
+    }
+    if (header.codec == Codec::STORE) {
+        return header.payload_length == header.raw_length;
+    }
+    return header.raw_length <= header.payload_length * MAX_INFLATION_RATIO;
+}
+
+double estimate_entropy(std::string_view data, size_t sample_bytes) {
+    if (data.empty() || sample_bytes == 0) {
+        return 0;
+    }
+
+    // Whole buffer if it's small, otherwise evenly spaced windows so a proof tail or a
+    // repetitive header can't dominate the estimate
+    uint32_t counts[256] = {0};
+    size_t sampled = 0;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    if (data.size() <= sample_bytes) {
+        for (size_t i = 0; i < data.size(); i++) {
+            counts[bytes[i]]++;
+        }
+        sampled = data.size();
+    } else {
+        const size_t WINDOWS = 16;
+        size_t window = std::max<size_t>(1, sample_bytes / WINDOWS);
+        size_t stride = data.size() / WINDOWS;
+        for (size_t w = 0; w < WINDOWS; w++) {
+            const uint8_t* start = bytes + w * stride;
+            for (size_t i = 0; i < window && w * stride + i < data.size(); i++) {
+                counts[start[i]]++;
+            }
+            sampled += std::min(window, data.size() - w * stride);
+        }
+    }
+
+    double entropy = 0;
+    for (uint32_t count : counts) {
+        if (count > 0) {
+            double p = static_cast<double>(count) / sampled;
+            entropy -= p * std::log2(p);
+        }
+    }
+    return entropy;
+}
+
+namespace {
+
+// Compressed / raw size of a FAST pass over a few evenly spaced contiguous windows of the
+// data, so repeats within a window and against the dictionary count as in the real pass.
+// Deflate is far costlier per byte than counting, so the trial takes a quarter of the sample.
+double trial_ratio(std::string_view data, size_t sample_bytes, const CompressionDictionary* dictionary) {
+    struct TrialStream {
+        z_stream stream;
+        TrialStream() {
+            std::memset(&stream, 0, sizeof(stream));
+            if (deflateInit(&stream, Z_BEST_SPEED) != Z_OK) {
+                throw std::runtime_error("Compression init failed!");
+            }
+        }
+        ~TrialStream() { deflateEnd(&stream); }
+    };
+    thread_local TrialStream trial;
+    thread_local std::string sample;
+    thread_local std::string out;
+
+    const size_t WINDOWS = 4;
+    sample_bytes = std::max<size_t>(WINDOWS, sample_bytes / 4);
+    sample.clear();
+    if (data.size() <= sample_bytes) {
+        sample.assign(data.data(), data.size());
+    } else {
+        size_t window = std::max<size_t>(1, sample_bytes / WINDOWS);
+        size_t stride = (data.size() - window) / (WINDOWS - 1);
+        for (size_t w = 0; w < WINDOWS; w++) {
+            sample.append(data.data() + w * stride, window);
+        }
+    }
+
+    z_stream& stream = trial.stream;
+    deflateReset(&stream);
+    if (dictionary != nullptr && !dictionary->get_bytes().empty()) {
+        const std::string& bytes = dictionary->get_bytes();
+        deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(bytes.data()), static_cast<uInt>(bytes.size()));
+    }
+    out.resize(deflateBound(&stream, static_cast<uLong>(sample.size())));
+    stream.next_in = reinterpret_cast<Bytef*>(&sample[0]);
+    stream.avail_in = static_cast<uInt>(sample.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        return 1;
+    }
+    return static_cast<double>(out.size() - stream.avail_out) / sample.size();
+}
+
+} // namespace
+
+Codec choose_codec(std::string_view data, const CompressionDictionary* dictionary, const CodecPolicy& policy) {
+    if (data.empty()) {
+        return Codec::STORE;
+    }
+    // A sample of n bytes can't show more than log2(min(n, 256)) bits per byte
+    size_t sampled = std::min(data.size(), policy.sample_bytes);
+    double ceiling = std::log2(static_cast<double>(std::min<size_t>(sampled, 256)));
+    if (ceiling <= 0) {
+        return Codec::STORE;
+    }
+    double ratio = estimate_entropy(data, policy.sample_bytes) / ceiling;
+    if (ratio >= policy.store_above) {
+        // Byte entropy can't see repeated high-entropy strings (hashes, addresses, dictionary
+        // content), so only store what a trial pass can't shrink either
+        return trial_ratio(data, policy.sample_bytes, dictionary) <= 1 - policy.trial_saving ? Codec::FAST : Codec::STORE;
+    }
+    return ratio >= policy.fast_above ? Codec::FAST : Codec::HIGH;
+}
+
+FrameCompressor::FrameCompressor(CodecLevels codec_levels)
+    : frame_start(0), raw_length(0), dictionary_id(0), codec(Codec::HIGH), transform(Transform::NONE), levels(codec_levels),
+      level(0), active(false) {
+    levels.fast = std::min(std::max(levels.fast, 1), 9);
+    levels.high = std::min(std::max(levels.high, 1), 9);
+    level = levels.high;
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit(&stream, level) != Z_OK) {
+        throw std::runtime_error("Compression init failed!");
+    }
+}
+
+FrameCompressor::~FrameCompressor() {
+    deflateEnd(&stream);
+}
+
+void FrameCompressor::begin(std::string& out, const CompressionDictionary* dictionary, Codec frame_codec,
+                            Transform frame_transform) {
+    if (active) {
+        throw std::runtime_error("Compression frame already open!");
+    }
+    codec = frame_codec;
+    transform = frame_transform;
+    dictionary_id = 0;
+    if (codec != Codec::STORE) {
+        deflateReset(&stream);
+        int frame_level = codec == Codec::FAST ? levels.fast : levels.high;
+        if (frame_level != level) {
+            // Nothing has been fed since the reset, so this only switches parameters
+            deflateParams(&stream, frame_level, Z_DEFAULT_STRATEGY);
+            level = frame_level;
+        }
+    }
+    if (codec != Codec::STORE && dictionary != nullptr && !dictionary->get_bytes().empty()) {
+        const std::string& bytes = dictionary->get_bytes();
+        if (deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(bytes.data()), static_cast<uInt>(bytes.size())) != Z_OK) {
+            throw std::runtime_error("Compression dictionary rejected!");
+        }
+        dictionary_id = dictionary->get_id();
+    }
+    frame_start = out.size();
+    out.append(FRAME_HEADER_SIZE, '\0');
+    raw_length = 0;
+    active = true;
+}
+
+void FrameCompressor::update(const void* data, size_t size, std::string& out) {
+    if (!active) {
+        throw std::runtime_error("No open compression frame!");
+    }
+    if (codec == Codec::STORE) {
+        out.append(static_cast<const char*>(data), size);
+        raw_length += size;
+        return;
+    }
+    const Bytef* input = static_cast<const Bytef*>(data);
+    while (size > 0) {
+        size_t piece = std::min(size, MAX_ZLIB_CHUNK);
+        stream.next_in = const_cast<Bytef*>(input);
+        stream.avail_in = static_cast<uInt>(piece);
+        deflate_into(Z_NO_FLUSH, out);
+        input += piece;
+        size -= piece;
+        raw_length += piece;
+    }
+}
+
+void FrameCompressor::finish(std::string& out) {
+    if (!active) {
+        throw std::runtime_error("No open compression frame!");
+    }
+    if (codec != Codec::STORE) {
+        stream.next_in = nullptr;
+        stream.avail_in = 0;
+        deflate_into(Z_FINISH, out);
+    }
+
+    size_t payload_length = out.size() - frame_start - FRAME_HEADER_SIZE;
+    if (payload_length > UINT32_MAX) {
+        throw std::runtime_error("Compression frame too large!");
+    }
+    uint8_t* header = reinterpret_cast<uint8_t*>(&out[frame_start]);
+    put_u32(header, FRAME_MAGIC);
+    put_u64(header + 4, raw_length);
+    put_u32(header + 12, static_cast<uint32_t>(payload_length));
+    put_u32(header + 16, dictionary_id);
+    header[20] = static_cast<uint8_t>(codec);
+    header[21] = static_cast<uint8_t>(transform);
+    active = false;
+}
+
+// Run deflate until it has consumed the pending input (and, for Z_FINISH, ended the stream),
+// growing out in place so compressed bytes are written directly into the caller's buffer
+void FrameCompressor::deflate_into(int flush, std::string& out) {
+    int result = Z_OK;
+    do {
+        size_t chunk = std::min(MAX_ZLIB_CHUNK, std::max<size_t>(MIN_OUTPUT_CHUNK, deflateBound(&stream, stream.avail_in)));
+        size_t used = out.size();
+        out.resize(used + chunk);
+        stream.next_out = reinterpret_cast<Bytef*>(&out[used]);
+        stream.avail_out = static_cast<uInt>(chunk);
+        result = deflate(&stream, flush);
+        if (result == Z_STREAM_ERROR) {
+            throw std::runtime_error("Compression failed!");
+        }
+        out.resize(out.size() - stream.avail_out);
+    } while (stream.avail_in > 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+}
+
+std::string FrameCompressor::compress(std::string_view data, const CompressionDictionary* dictionary, Codec frame_codec) {
+    std::string out;
+    size_t bound = frame_codec == Codec::STORE ? data.size() : deflateBound(&stream, static_cast<uLong>(data.size()));
+    out.reserve(FRAME_HEADER_SIZE + bound);
+    begin(out, dictionary, frame_codec);
+    update(data.data(), data.size(), out);
+    finish(out);
+    return out;
+}
+
+std::string FrameCompressor::compress(std::string_view data, const CompressionDictionary* dictionary) {
+    return compress(data, dictionary, choose_codec(data, dictionary));
+}
+
+FrameDecompressor::FrameDecompressor() {
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+        throw std::runtime_error("Decompression init failed!");
+    }
+}
 
-    int result = uncompress(decompressedData.data(), &decompressedSize, compressedData.data(), compressedData.size());
-    while (result == Z_BUF_ERROR) {
-        // Increase buffer size if it's not enough to decompress
-        decompressedSize *= 2;
-        decompressedData.resize(decompressedSize);
-        result = uncompress(decompressedData.data(), &decompressedSize, compressedData.data(), compressedData.size());
+FrameDecompressor::~FrameDecompressor() {
+    inflateEnd(&stream);
+}
+
+size_t FrameDecompressor::decompress_into(std::string_view frame, uint8_t* out, size_t capacity,
+                                          const DictionaryRegistry* dictionaries) {
+    FrameHeader header;
+    if (!parse_frame_header(frame, header)) {
+        throw std::runtime_error("Invalid compression frame!");
+    }
+    if (header.raw_length > capacity) {
+        throw std::runtime_error("Compression frame does not fit the output buffer!");
+    }
+    decode(header, frame.data() + FRAME_HEADER_SIZE, out, header.raw_length, dictionaries);
+    return FRAME_HEADER_SIZE + header.payload_length;
+}
+
+void FrameDecompressor::decompress_prefix(std::string_view frame, uint8_t* out, size_t length,
+                                          const DictionaryRegistry* dictionaries) {
+    FrameHeader header;
+    if (!parse_frame_header(frame, header)) {
+        throw std::runtime_error("Invalid compression frame!");
+    }
+    if (length > header.raw_length) {
+        throw std::runtime_error("Requested bytes lie past the end of the frame!");
+    }
+    decode(header, frame.data() + FRAME_HEADER_SIZE, out, length, dictionaries);
+}
+
+// Decode the first length bytes of the payload. Stored payloads are copied directly; deflated
+// ones inflate until exactly length bytes are out (one call for a well-formed frame, plus one
+// to supply its dictionary), so a prefix never pays for the rest of the frame.
+void FrameDecompressor::decode(const FrameHeader& header, const char* payload, uint8_t* out, size_t length,
+                               const DictionaryRegistry* dictionaries) {
+    switch (header.codec) {
+    case Codec::STORE:
+        if (length > 0) {
+            std::memcpy(out, payload, length);
+        }
+        return;
+    case Codec::FAST:
+    case Codec::HIGH:
+        break;
+    default:
+        throw std::runtime_error("Unknown compression codec!");
     }
 
-    if (result != Z_OK) {
+    bool whole = length == header.raw_length;
+    int flush = whole ? Z_FINISH : Z_NO_FLUSH;
+    inflateReset(&stream);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(payload));
+    stream.avail_in = header.payload_length;
+    stream.next_out = out;
+    stream.avail_out = static_cast<uInt>(length);
+
+    int result = inflate(&stream, flush);
+    if (result == Z_NEED_DICT) {
+        std::shared_ptr<const CompressionDictionary> dictionary =
+            header.dictionary_id != 0 && dictionaries != nullptr ? dictionaries->get(header.dictionary_id) : nullptr;
+        if (!dictionary) {
+            throw std::runtime_error("Unknown compression dictionary!");
+        }
+        const std::string& bytes = dictionary->get_bytes();
+        if (inflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(bytes.data()), static_cast<uInt>(bytes.size())) != Z_OK) {
+            throw std::runtime_error("Compression dictionary does not match the frame!");
+        }
+        result = inflate(&stream, flush);
+    }
+    bool finished = whole ? result == Z_STREAM_END : (result == Z_OK || result == Z_STREAM_END || result == Z_BUF_ERROR);
+    if (!finished || stream.total_out != length) {
         throw std::runtime_error("Decompression failed!");
     }
+}
+
+std::string FrameDecompressor::decompress(std::string_view frame, const DictionaryRegistry* dictionaries) {
+    FrameHeader header;
+    if (!parse_frame_header(frame, header)) {
+        throw std::runtime_error("Invalid compression frame!");
+    }
+    std::string out(header.raw_length, '\0');
+    decompress_into(frame, reinterpret_cast<uint8_t*>(&out[0]), out.size(), dictionaries);
+    switch (header.transform) {
+    case Transform::NONE:
+        return out;
+    case Transform::COLUMNAR: {
+        std::string block_bytes;
+        if (!BlockColumns::decode(out, block_bytes)) {
+            throw std::runtime_error("Columnar block is malformed!");
+        }
+        return block_bytes;
+    }
+    default:
+        throw std::runtime_error("Unknown compression transform!");
+    }
+}
+
+std::string compress_data(std::string_view data, const CompressionDictionary* dictionary) {
+    thread_local FrameCompressor compressor;
+    return compressor.compress(data, dictionary);
+}
+
+std::string decompress_data(std::string_view compressed_data, const DictionaryRegistry* dictionaries) {
+    thread_local FrameDecompressor decompressor;
+    return decompressor.decompress(compressed_data, dictionaries);
+}
+
+std::string block_compression_input(std::string_view encoded_block) {
+    std::string columns;
+    if (!BlockColumns::encode(encoded_block, columns)) {
+        return std::string(encoded_block);
+    }
+    return columns;
+}
+
+std::string compress_block_data(std::string_view encoded_block, const CompressionDictionary* dictionary) {
+    thread_local FrameCompressor compressor;
+    return compress_block_data(compressor, encoded_block, dictionary);
+}
+
+std::string compress_block_data(FrameCompressor& compressor, std::string_view encoded_block,
+                                const CompressionDictionary* dictionary) {
+    thread_local std::string columns;
+    if (!BlockColumns::encode(encoded_block, columns)) {
+        return compressor.compress(encoded_block, dictionary);
+    }
+    // Proofs are near-random and would swamp the entropy sample, so the codec follows the
+    // columns in front of them; deflate passes the proof stream through cheaply either way
+    BlockColumns::ColumnsView view;
+    view.parse(columns);
+    std::string_view structured(columns.data(), view.proofs.data() - columns.data());
 
-    decompressedData.resize(decompressedSize);  // Resize to actual decompressed data size
+    std::string out;
+    out.reserve(FRAME_HEADER_SIZE + columns.size());
+    compressor.begin(out, dictionary, choose_codec(structured, dictionary), Transform::COLUMNAR);
+    compressor.update(columns.data(), columns.size(), out);
+    compressor.finish(out);
+    return out;
+}
+
+std::string decompress_columns(std::string_view frame, const DictionaryRegistry* dictionaries) {
+    FrameHeader header;
+    if (!parse_frame_header(frame, header) || header.transform != Transform::COLUMNAR) {
+        throw std::runtime_error("Not a columnar block frame!");
+    }
+    thread_local FrameDecompressor decompressor;
+    std::string out(header.raw_length, '\0');
+    decompressor.decompress_into(frame, reinterpret_cast<uint8_t*>(&out[0]), out.size(), dictionaries);
+    return out;
+}
+
+// Greedy segment selection: every GRAM-byte substring is scored by how many samples
+// contain it, each candidate segment by the summed score of the grams it doesn't share with
+// segments already chosen. Grams seen in a single sample are noise and score nothing.
+std::shared_ptr<const CompressionDictionary> CompressionDictionary::train(uint32_t id, const std::vector<std::string>& samples,
+                                                                          size_t max_size) {
+    const size_t GRAM = 8;
+    const size_t SEGMENT = 64;
+    max_size = max_size < MAX_SIZE ? max_size : static_cast<size_t>(MAX_SIZE);
+
+    // Document frequency of each gram, counted once per sample
+    struct GramCount {
+        uint32_t samples = 0;
+        size_t last_sample = SIZE_MAX;
+    };
+    std::unordered_map<std::string_view, GramCount> grams;
+    for (size_t sample = 0; sample < samples.size(); sample++) {
+        std::string_view data(samples[sample]);
+        for (size_t pos = 0; pos + GRAM <= data.size(); pos++) {
+            GramCount& count = grams[data.substr(pos, GRAM)];
+            if (count.last_sample != sample) {
+                count.last_sample = sample;
+                count.samples++;
+            }
+        }
+    }
+
+    auto score = [&](std::string_view segment, const std::unordered_map<std::string_view, bool>* covered) {
+        uint64_t total = 0;
+        for (size_t pos = 0; pos + GRAM <= segment.size(); pos++) {
+            std::string_view gram = segment.substr(pos, GRAM);
+            uint32_t count = grams[gram].samples;
+            if (count > 1 && (covered == nullptr || covered->find(gram) == covered->end())) {
+                total += count;
+            }
+        }
+        return total;
+    };
+
+    // Candidate segments on a half-overlapping grid, best first
+    std::vector<std::pair<uint64_t, std::string_view>> candidates;
+    for (const auto& sample : samples) {
+        std::string_view data(sample);
+        for (size_t pos = 0; pos < data.size(); pos += SEGMENT / 2) {
+            std::string_view segment = data.substr(pos, SEGMENT);
+            uint64_t initial = score(segment, nullptr);
+            if (initial > 0) {
+                candidates.emplace_back(initial, segment);
+            }
+        }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    // Keep segments that still add at least half their value once overlap with chosen ones is removed
+    std::unordered_map<std::string_view, bool> covered;
+    std::vector<std::string_view> chosen;
+    size_t total_size = 0;
+    for (const auto& candidate : candidates) {
+        if (total_size + candidate.second.size() > max_size) {
+            continue;
+        }
+        if (score(candidate.second, &covered) * 2 < candidate.first) {
+            continue;
+        }
+        for (size_t pos = 0; pos + GRAM <= candidate.second.size(); pos++) {
+            covered[candidate.second.substr(pos, GRAM)] = true;
+        }
+        chosen.push_back(candidate.second);
+        total_size += candidate.second.size();
+    }
+
+    // Most valuable segments go last, nearest to the data being compressed
+    std::string bytes;
+    bytes.reserve(total_size);
+    for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) {
+        bytes.append(it->data(), it->size());
+    }
+    return std::make_shared<const CompressionDictionary>(id, std::move(bytes));
+}
+
+bool DictionaryRegistry::add(std::shared_ptr<const CompressionDictionary> dictionary) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (dictionary->get_id() == 0) {
+        return false;
+    }
+    return dictionaries.emplace(dictionary->get_id(), std::move(dictionary)).second;
+}
+
+std::shared_ptr<const CompressionDictionary> DictionaryRegistry::get(uint32_t id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = dictionaries.find(id);
+    return it == dictionaries.end() ? nullptr : it->second;
+}
+
+uint32_t DictionaryRegistry::next_id() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t highest = 0;
+    for (const auto& entry : dictionaries) {
+        highest = std::max(highest, entry.first);
+    }
+    return highest + 1;
+}
+
+// Compress data into a single frame
+std::vector<uint8_t> compress(const std::vector<uint8_t>& inputData) {
+    std::string frame = compress_data(std::string_view(reinterpret_cast<const char*>(inputData.data()), inputData.size()));
+    return std::vector<uint8_t>(frame.begin(), frame.end());
+}
+
+// Decompress a frame; the stored length sizes the output, so there is no guess-and-retry
+std::vector<uint8_t> decompress(const std::vector<uint8_t>& compressedData) {
+    std::string_view frame(reinterpret_cast<const char*>(compressedData.data()), compressedData.size());
+    FrameHeader header;
+    if (!parse_frame_header(frame, header)) {
+        throw std::runtime_error("Decompression failed!");
+    }
+    thread_local FrameDecompressor decompressor;
+    std::vector<uint8_t> decompressedData(header.raw_length);
+    decompressor.decompress_into(frame, decompressedData.data(), decompressedData.size());
     return decompressedData;
 }
 
-// Recursive compression to optimize the blockchain's data footprint
-std::vector<uint8_t> recursiveCompress(const std::vector<uint8_t>& inputData) {
-    if (inputData.size() < MIN_COMPRESSION_THRESHOLD) {
-        // Base case: data is small enough to not compress further
-        return inputData;
+Compression::~Compression() {
+    blockchain->on_blocks_connected = nullptr;
+    if (compactor) {
+        compactor->stop();
     }
+}
 
-    // First round of compression using zlib
-    std::vector<uint8_t> compressedData = compress(inputData);
+size_t Compression::seal_archives() {
+    size_t sealed = 0;
+    uint64_t settled = blockchain->chain.first_height();
+    for (; archive_span > 0 && archive_fed < settled; archive_fed++) {
+        std::shared_ptr<Block> block = history_block(archive_fed);
+        if (!block) {
+            // A height nothing kept ends the open segment early; archiving resumes after it
+            sealed += seal_open_archive(archive_fed + 1);
+            continue;
+        }
+        if (!archive_writer) {
+            archive_writer = std::make_shared<ArchiveWriter>(archive_frame_blocks, dictionary.get());
+        }
+        archive_writer->add_block(*block);
+        if (archive_writer->block_count() >= archive_span) {
+            sealed += seal_open_archive(archive_fed + 1);
+        }
+    }
+    return sealed;
+}
 
-    // Recursively compress the result if it still meets the threshold
-    if (compressedData.size() < inputData.size()) {
-        return recursiveCompress(compressedData);
+size_t Compression::seal_open_archive(uint64_t next) {
+    std::shared_ptr<ArchiveReader> reader;
+    if (archive_writer) {
+        reader = std::make_shared<ArchiveReader>();
+        if (!reader->open(archive_writer->finish(), &dictionaries)) {
+            throw std::runtime_error("Sealed archive segment is malformed!");
+        }
+        archive_writer.reset();
     }
 
-    // If compression doesn't help, return the original data
-    return inputData;
+    std::unique_lock<std::shared_mutex> lock(frames_mutex);
+    archive_next = next;
+    if (!reader) {
+        return 0;
+    }
+    archives.push_back(std::move(reader));
+    return 1;
+}
+
+std::shared_ptr<const ArchiveReader> Compression::find_archive(uint64_t height) const {
+    std::shared_lock<std::shared_mutex> lock(frames_mutex);
+    auto it = std::upper_bound(archives.begin(), archives.end(), height,
+                               [](uint64_t h, const std::shared_ptr<const ArchiveReader>& archive) {
+                                   return h < archive->first_height();
+                               });
+    if (it == archives.begin() || !(*--it)->contains(height)) {
+        return nullptr;
+    }
+    return *it;
+}
+
+std::shared_ptr<Block> Compression::read_archived_block(uint64_t height) const {
+    std::shared_ptr<const ArchiveReader> archive = find_archive(height);
+    return archive ? archive->read_block(height) : nullptr;
+}
+
+bool Compression::get_archived_frame(uint64_t height, std::string& frame) const {
+    std::shared_ptr<const ArchiveReader> archive = find_archive(height);
+    if (!archive) {
+        return false;
+    }
+    frame.assign(archive->frame_for(height));
+    return !frame.empty();
 }
 
 // Function to test compression and decompression
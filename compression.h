@@ -7,89 +7,535 @@
 #include <unordered_map>
 #include <algorithm>
 #include <cassert>
+#include <memory>
+#include <string_view>
+#include <stdexcept>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <zlib.h>
+#include "blockchain.h"
+#include "block_codec.h"
+#include "epoch_summary.h"
+#include "block_cache.h"
+#include "block_compactor.h"
 
-// Forward declarations
-class Block;
-class Blockchain;
-
-// Compcrypt namespace for handling the recursive compression
+// Compcrypt namespace for framed block compression
 namespace Compcrypt {
 
-// Recursive compression function that is used to shrink blocks and chain data
-std::string compress_data(const std::string& data);
+// Every compressed payload is a self-describing frame:
+//   u32 magic | u64 raw_length | u32 payload_length | u32 dictionary_id | u8 codec | u8 transform | u8[2] reserved | payload
+// All integers are little-endian. Storing raw_length lets the decoder size its output once
+// and inflate in a single pass; frames can be concatenated back to back. dictionary_id is 0
+// for frames compressed without a preset dictionary. The codec tag tells the decoder how the
+// payload was written, so it dispatches without probing. transform says how the bytes were
+// rearranged before compression; raw_length counts the transformed bytes.
+const uint32_t FRAME_MAGIC = 0x31464343;  // "CCF1"
+const size_t FRAME_HEADER_SIZE = 24;
+
+// How a frame's payload is encoded
+enum class Codec : uint8_t {
+    STORE = 0,   // Raw bytes (incompressible data such as SNARK proofs)
+    FAST = 1,    // zlib level 1 unless CodecLevels says otherwise
+    HIGH = 2     // zlib level 9 unless CodecLevels says otherwise
+};
+
+// zlib levels a FrameCompressor uses for each codec (the decoder doesn't need them)
+struct CodecLevels {
+    int fast = 1;
+    int high = 9;
+};
+
+// How the raw bytes were rearranged before compression
+enum class Transform : uint8_t {
+    NONE = 0,
+    COLUMNAR = 1   // An encoded block rewritten as columns (see block_columns.h)
+};
+
+struct FrameHeader {
+    uint64_t raw_length;       // Bytes after decompression
+    uint32_t payload_length;   // Compressed bytes following the header
+    uint32_t dictionary_id;    // Preset dictionary the payload was compressed with (0 = none)
+    Codec codec;               // Payload encoding
+    Transform transform;       // Undone after decoding the payload
+};
+
+// Thresholds for choosing a codec, as a fraction of the highest entropy the sample could show
+struct CodecPolicy {
+    double store_above = 0.95;   // Near-random: compressing would only burn cycles
+    double fast_above = 0.75;    // Some redundancy: a cheap pass gets most of it
+    double trial_saving = 0.03;  // Near-random samples still get FAST if a trial pass saves this much
+    size_t sample_bytes = 4096;  // Bytes inspected per payload (spread over the whole buffer)
+};
+
+// Shannon entropy in bits per byte over a strided sample of the data
+double estimate_entropy(std::string_view data, size_t sample_bytes = 4096);
+
+class CompressionDictionary;
+
+// Pick store / fast / high for a payload from its sampled entropy; a sample that looks
+// near-random is trial-compressed with FAST (primed with the dictionary the payload will use)
+// before falling back to STORE. O(sample_bytes)
+Codec choose_codec(std::string_view data, const CompressionDictionary* dictionary = nullptr,
+                   const CodecPolicy& policy = CodecPolicy());
 
-// Recursive decompression function that restores compressed data
-std::string decompress_data(const std::string& compressed_data);
+// Preset deflate dictionary trained from sample blocks. Small blocks share field layouts,
+// address prefixes and proof headers, so priming the compressor with those bytes lets even
+// the first occurrence in a block be encoded as a back-reference.
+class CompressionDictionary {
+public:
+    // Dictionaries are capped at the deflate window; bytes beyond it could never be referenced
+    static const size_t MAX_SIZE = 32 * 1024;
+
+    CompressionDictionary(uint32_t id, std::string bytes) : id(id), bytes(std::move(bytes)) {}
+
+    // Build a dictionary from sample payloads (e.g. encoded recent blocks). Segments whose
+    // substrings recur across the most samples are kept, the most common last so they sit
+    // closest to the data and get the shortest distances.
+    static std::shared_ptr<const CompressionDictionary> train(uint32_t id, const std::vector<std::string>& samples,
+                                                              size_t max_size = MAX_SIZE);
+
+    uint32_t get_id() const { return id; }
+    const std::string& get_bytes() const { return bytes; }
+
+private:
+    uint32_t id;         // Version referenced by frames; never 0
+    std::string bytes;
+};
+
+// Every dictionary version a node has used, so frames written with an older version stay readable
+class DictionaryRegistry {
+public:
+    // Register a dictionary; false if its id is 0 or already taken
+    bool add(std::shared_ptr<const CompressionDictionary> dictionary);
+
+    // Dictionary by id (nullptr if unknown)
+    std::shared_ptr<const CompressionDictionary> get(uint32_t id) const;
 
-// Compcrypt: Recursive data compression algorithm for blockchain blocks
+    // Id to use for the next trained dictionary
+    uint32_t next_id() const;
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<uint32_t, std::shared_ptr<const CompressionDictionary>> dictionaries;
+};
+
+// Parse the header at the start of frame; false if it's truncated, not a frame, or claims a
+// raw_length its payload could not decode to (callers size buffers from raw_length)
+bool parse_frame_header(std::string_view frame, FrameHeader& header);
+
+// Streaming frame encoder with a reusable z_stream (one per thread; not thread-safe).
+// Input can be fed in chunks as it arrives; compressed bytes are appended to the caller's buffer.
+class FrameCompressor {
+public:
+    explicit FrameCompressor(CodecLevels levels = CodecLevels());
+    ~FrameCompressor();
+
+    FrameCompressor(const FrameCompressor&) = delete;
+    FrameCompressor& operator=(const FrameCompressor&) = delete;
+
+    // Start a frame at the end of out (reserves room for the header), optionally primed with a
+    // dictionary; stored frames ignore the dictionary. transform only tags the frame: the
+    // caller feeds bytes it has already transformed.
+    void begin(std::string& out, const CompressionDictionary* dictionary = nullptr, Codec codec = Codec::HIGH,
+               Transform transform = Transform::NONE);
+
+    // Compress the next chunk of input into out
+    void update(const void* data, size_t size, std::string& out);
+
+    // Flush the stream and fill in the frame header
+    void finish(std::string& out);
+
+    // Compress a whole buffer into one frame with the given codec
+    std::string compress(std::string_view data, const CompressionDictionary* dictionary, Codec codec);
+
+    // Compress a whole buffer into one frame, choosing the codec from a sample of it
+    std::string compress(std::string_view data, const CompressionDictionary* dictionary = nullptr);
+
+private:
+    void deflate_into(int flush, std::string& out);
+
+    z_stream stream;
+    size_t frame_start;    // Offset of the open frame's header in the output buffer
+    uint64_t raw_length;   // Input fed into the open frame so far
+    uint32_t dictionary_id;  // Dictionary the open frame was primed with (0 = none)
+    Codec codec;             // Codec of the open frame
+    Transform transform;     // Transform tag of the open frame
+    CodecLevels levels;      // Levels for FAST and HIGH frames (clamped to 1..9)
+    int level;               // zlib level the stream is currently set to
+    bool active;
+};
+
+// Frame decoder with a reusable z_stream (one per thread; not thread-safe).
+// The frame header gives the exact output size, so output is written in a single inflate pass.
+class FrameDecompressor {
+public:
+    FrameDecompressor();
+    ~FrameDecompressor();
+
+    FrameDecompressor(const FrameDecompressor&) = delete;
+    FrameDecompressor& operator=(const FrameDecompressor&) = delete;
+
+    // Decompress one frame into a caller-provided buffer of at least raw_length bytes;
+    // returns the number of input bytes the frame occupied. Frames that reference a
+    // dictionary need the registry that holds it. The payload is written as stored, so a
+    // transformed frame yields its transformed bytes; decompress() undoes the transform.
+    size_t decompress_into(std::string_view frame, uint8_t* out, size_t capacity,
+                           const DictionaryRegistry* dictionaries = nullptr);
+
+    // Decompress one frame into a new string, undoing its transform
+    std::string decompress(std::string_view frame, const DictionaryRegistry* dictionaries = nullptr);
+
+    // Decode only the first length bytes of a frame; inflating stops as soon as they are out
+    void decompress_prefix(std::string_view frame, uint8_t* out, size_t length,
+                           const DictionaryRegistry* dictionaries = nullptr);
+
+private:
+    void decode(const FrameHeader& header, const char* payload, uint8_t* out, size_t length,
+                const DictionaryRegistry* dictionaries);
+
+    z_stream stream;
+};
+
+// Compress data into a single frame using this thread's compressor
+std::string compress_data(std::string_view data, const CompressionDictionary* dictionary = nullptr);
+
+// Restore data from a frame using this thread's decompressor; throws on corrupt frames or unknown dictionaries
+std::string decompress_data(std::string_view compressed_data, const DictionaryRegistry* dictionaries = nullptr);
+
+// Compress an encoded block with its transactions rewritten as columns first, so addresses,
+// amounts, timestamps and proofs each compress among their own kind. decompress_data()
+// returns the canonical encoding. Bytes that don't parse as a block are compressed as is.
+std::string compress_block_data(std::string_view encoded_block, const CompressionDictionary* dictionary = nullptr);
+
+// The same with a caller-owned compressor (e.g. one configured with other CodecLevels)
+std::string compress_block_data(FrameCompressor& compressor, std::string_view encoded_block,
+                                const CompressionDictionary* dictionary = nullptr);
+
+// The bytes compress_block_data() feeds the compressor for an encoded block: its columns, or
+// the encoding itself if it doesn't parse. Dictionaries for block frames are trained on these.
+std::string block_compression_input(std::string_view encoded_block);
+
+// Columnar bytes of a block frame without rebuilding rows, for column scans
+// (BlockColumns::ColumnsView); throws if the frame isn't columnar
+std::string decompress_columns(std::string_view frame, const DictionaryRegistry* dictionaries = nullptr);
+
+class ArchiveReader;
+class ArchiveWriter;
+
+// Compcrypt: per-block frame compression, epoch summaries and archives for a Blockchain
 class Compression {
 public:
     Blockchain* blockchain;    // Pointer to the blockchain, used to handle blocks and state
-    std::unordered_map<std::string, std::string> compressed_blocks; // Map to store compressed blocks
+    DictionaryRegistry dictionaries;  // Every dictionary version used by the stored frames
+    std::shared_ptr<const CompressionDictionary> dictionary;  // Dictionary for new blocks (nullptr = none)
+    size_t max_workers;  // Concurrency limit for whole-chain compression (1 = compress on the calling thread)
+    EpochSummaryTree summaries;  // Incrementally built compressed epoch summaries of the chain
+    BlockCache cache;  // Decompressed blocks, so hot reads skip inflate + decode
+    std::shared_ptr<BlockCompactor> compactor;  // Background compaction of cold blocks (nullptr = not started)
+    uint64_t archive_span;        // Settled heights per sealed archive segment (0 = don't archive)
+    size_t archive_frame_blocks;  // Blocks per independently decodable archive frame
 
     // Constructor to initialize the Compression class
-    Compression(Blockchain* chain) : blockchain(chain) {}
+    Compression(Blockchain* chain, size_t workers = std::max(1u, std::thread::hardware_concurrency()))
+        : blockchain(chain), max_workers(workers), archive_span(1024), archive_frame_blocks(4), archive_next(0),
+          archive_fed(0) {}
+
+    // Unhooks from the blockchain (released blocks stay readable through the compactor)
+    ~Compression();
 
-    // Compress the data in a block (used for recursive compression)
+    Compression(const Compression&) = delete;
+    Compression& operator=(const Compression&) = delete;
+
+    // Train a new dictionary version from the most recent held blocks, in the columnar layout
+    // block frames are compressed in, and use it for new blocks; blocks compressed with
+    // earlier versions stay readable through the registry
+    void train_dictionary(size_t sample_blocks = 256) {
+        std::vector<std::string> samples;
+        uint64_t first = blockchain->chain.first_height();
+        uint64_t end = blockchain->chain.next_height();
+        uint64_t start = end - first > sample_blocks ? end - sample_blocks : first;
+        for (uint64_t height = start; height < end; height++) {
+            if (std::shared_ptr<Block> block = blockchain->get_block(height)) {
+                samples.push_back(block_compression_input(BlockCodec::encode_block(*block)));
+            }
+        }
+
+        std::shared_ptr<const CompressionDictionary> trained = CompressionDictionary::train(dictionaries.next_id(), samples);
+        if (trained->get_bytes().empty()) {
+            return;  // Not enough repetition across the samples to be worth a dictionary
+        }
+        dictionaries.add(trained);
+        dictionary = trained;
+        if (compactor) {
+            compactor->set_dictionary(trained);
+        }
+        std::cout << "Compression dictionary " << trained->get_id() << " trained: " << trained->get_bytes().size() << " bytes" << std::endl;
+    }
+
+    // Compress the block's binary encoding (the same bytes that are hashed and gossiped)
     void compress_block(Block* block) {
-        // Convert the block's data to string (or another format) for compression
-        std::string block_data = block->get_data();
+        store_frame(block->get_block_hash(), encode_compressed(*block));
+    }
 
-        // Apply the recursive compression
-        std::string compressed_data = compress_data(block_data);
+    // Decompress a block's encoding and rebuild it (nullptr if it was never compressed or is corrupt)
+    std::shared_ptr<Block> decompress_block(const Block* block) {
+        return load_block(block->get_block_hash());
+    }
 
-        // Store the compressed block
-        compressed_blocks[block->get_hash()] = compressed_data;
+    // Decoded block by hash: blocks the compactor still holds hot are returned as is, the
+    // rest go through the cache and only misses decompress
+    std::shared_ptr<Block> load_block(const Hash256& hash) {
+        if (compactor) {
+            if (std::shared_ptr<Block> hot = compactor->find_hot(hash)) {
+                return hot;
+            }
+        }
+        return cache.get_or_load(hash, [&]() -> std::shared_ptr<Block> {
+            if (std::shared_ptr<const std::string> frame = get_frame(hash)) {
+                return decode_compressed(*frame);
+            }
+            if (compactor) {
+                if (std::shared_ptr<Block> block = compactor->load(hash)) {
+                    return block;
+                }
+            }
+            // Spilled by the compactor or pruned: the store still has it
+            return blockchain->store ? blockchain->store->read_block_by_hash(hash) : nullptr;
+        });
+    }
 
-        // Update the block data with compressed version
-        block->set_compressed_data(compressed_data);
+    // Compressed frame of a block compressed by compress_block()/compress_blockchain() (nullptr if none)
+    std::shared_ptr<const std::string> get_frame(const Hash256& hash) const {
+        std::shared_lock<std::shared_mutex> lock(frames_mutex);
+        auto it = compressed_blocks.find(hash);
+        return it == compressed_blocks.end() ? nullptr : it->second;
+    }
 
-        std::cout << "Block compressed: " << block->get_hash() << std::endl;
+    size_t compressed_count() const {
+        std::shared_lock<std::shared_mutex> lock(frames_mutex);
+        return compressed_blocks.size();
     }
 
-    // Decompress the block's data for validation and restoration
-    void decompress_block(Block* block) {
-        std::string compressed_data = compressed_blocks[block->get_hash()];
+    // Start compacting cold blocks on a background thread instead of compressing the whole
+    // chain at once. Blocks are handed over by track_blocks(), which add_block() now calls,
+    // and once compacted the ring drops its copy and reloads through the compactor.
+    void start_compaction(CompactionPolicy policy = CompactionPolicy()) {
+        if (compactor) {
+            return;
+        }
+        compactor = std::make_shared<BlockCompactor>(&dictionaries, policy);
+        compactor->set_dictionary(dictionary);
+        // The loader owns the compactor, so released blocks stay readable after this object is gone
+        blockchain->cold_loader = [compactor = compactor](uint64_t height) { return compactor->load_height(height); };
+        blockchain->on_blocks_connected = [this] { track_blocks(); };
+        track_blocks();
+        compactor->start();
+    }
 
-        // Decompress the block's data
-        std::string original_data = decompress_data(compressed_data);
+    void stop_compaction() {
+        if (compactor) {
+            compactor->stop();
+        }
+    }
 
-        // Restore the original block's data
-        block->set_data(original_data);
+    // Hand blocks connected since the last call to the compactor and release the ring's copy
+    // of blocks it has compacted; no compression on this thread beyond archiving the blocks
+    // that just left the ring. Tips replaced by a fork switch are re-tracked. Blocks pruned
+    // from the ring stay compacted until the store or a sealed archive segment holds them;
+    // frames of blocks held there may also be spilled to meet the footprint target.
+    size_t track_blocks() {
+        if (!compactor) {
+            return 0;
+        }
+        uint64_t first = blockchain->chain.first_height();
+        uint64_t tip = blockchain->chain.next_height();
+        uint64_t height = std::max(first, std::min(compactor->next_height(), tip));
+        while (height > first) {
+            std::shared_ptr<Block> below = blockchain->get_block(height - 1);
+            if (below && compactor->contains(below->get_block_hash())) {
+                break;
+            }
+            height--;
+        }
+        for (uint64_t h = height; h < tip; h++) {
+            if (std::shared_ptr<Block> block = blockchain->get_block(h)) {
+                compactor->track(std::move(block));
+            }
+        }
+        for (const auto& compacted : compactor->take_compacted()) {
+            blockchain->release_block(compacted.first, compacted.second);
+        }
 
-        std::cout << "Block decompressed: " << block->get_hash() << std::endl;
+        seal_archives();
+        uint64_t durable = blockchain->store ? tip : archived_height();
+        compactor->set_spill_height(durable);
+        compactor->prune_below(std::min(first, durable));
+        return tip - height;
     }
 
-    // Compress the entire blockchain recursively to ensure fixed size
+    // Feed settled history (heights below the held chain, which can't be reorganized any more)
+    // into the open archive segment, taking pruned blocks from the store or the compactor, and
+    // seal it every archive_span blocks; returns the number of segments sealed. Each call only
+    // encodes the blocks pruned since the last one.
+    size_t seal_archives();
+
+    // One archived block, or the compressed frame holding it as it would be sent to a peer;
+    // only that frame is inflated (nullptr / false if the height isn't archived)
+    std::shared_ptr<Block> read_archived_block(uint64_t height) const;
+    bool get_archived_frame(uint64_t height, std::string& frame) const;
+
+    // Height after the newest archived block
+    uint64_t archived_height() const {
+        std::shared_lock<std::shared_mutex> lock(frames_mutex);
+        return archive_next;
+    }
+
+    // Compress every held block. Heights are sharded into contiguous ranges across up to
+    // max_workers pool threads, each with its own thread-local codec; results are stored in
+    // height order on the calling thread.
     void compress_blockchain() {
-        for (auto& block : blockchain->get_blocks()) {
-            compress_block(block);
+        uint64_t first = blockchain->chain.first_height();
+        std::vector<std::string> frames(blockchain->chain.size());
+        std::vector<Hash256> hashes(frames.size());
+        for_each_shard(frames.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                if (std::shared_ptr<Block> block = blockchain->get_block(first + i)) {
+                    frames[i] = encode_compressed(*block);
+                    hashes[i] = block->get_block_hash();
+                }
+            }
+        });
+
+        for (size_t i = 0; i < frames.size(); i++) {
+            if (!frames[i].empty()) {
+                store_frame(hashes[i], std::move(frames[i]));
+            }
         }
-        std::cout << "Blockchain compressed recursively." << std::endl;
+        std::cout << "Blockchain compressed (" << frames.size() << " blocks)." << std::endl;
     }
 
-    // Decompress the entire blockchain to restore original state
-    void decompress_blockchain() {
-        for (auto& block : blockchain->get_blocks()) {
-            decompress_block(block);
+    // Fold blocks the summary tree hasn't seen into it, dropping summaries of pruned heights.
+    // Replaced tips (fork switches) are truncated first; returns the number of blocks appended.
+    size_t update_summaries() {
+        uint64_t tip = blockchain->chain.next_height();
+        summaries.prune_below(blockchain->chain.first_height());
+        if (summaries.next_height() > tip) {
+            summaries.truncate(tip);
+        }
+        while (!summaries.empty() && blockchain->chain.contains(summaries.next_height() - 1) &&
+               summaries.back()->last_block_hash !=
+                   blockchain->get_block(summaries.next_height() - 1)->get_block_hash()) {
+            summaries.truncate(summaries.next_height() - 1);
+        }
+
+        size_t appended = 0;
+        for (uint64_t height = summaries.next_height(); height < tip; height++) {
+            std::shared_ptr<Block> block = blockchain->get_block(height);
+            if (!block) {
+                // A gap (pruned without an archive): restart the tree at the oldest held block
+                summaries.reset(blockchain->chain.first_height());
+                return appended + update_summaries();
+            }
+            summaries.append(*block);
+            appended++;
         }
+        return appended;
+    }
+
+    // Rebuild blocks [start, end) from at most O(log n) epoch summaries
+    std::vector<std::shared_ptr<Block>> read_summarized_range(uint64_t start, uint64_t end) const {
+        return summaries.read_range(start, end);
+    }
+
+    // Decompress every held block in parallel; restored blocks are returned in height order
+    // (nullptr where a block was never compressed or its frame is corrupt)
+    std::vector<std::shared_ptr<Block>> decompress_blockchain() {
+        uint64_t first = blockchain->chain.first_height();
+        std::vector<std::shared_ptr<Block>> restored(blockchain->chain.size());
+        for_each_shard(restored.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                std::shared_ptr<Block> held = blockchain->get_block(first + i);
+                restored[i] = held ? load_block(held->get_block_hash()) : nullptr;
+            }
+        });
         std::cout << "Blockchain decompressed and restored to original state." << std::endl;
+        return restored;
     }
-};
 
-// Recursive compression method (stubbed out for the purpose of this example)
-std::string compress_data(const std::string& data) {
-    // Placeholder for actual compression logic
-    std::string compressed = data; // This would actually be compressed data
-    return compressed;  // Return the compressed data (in reality, you would apply a compression algorithm)
-}
-
-// Recursive decompression method (stubbed out for the purpose of this example)
-std::string decompress_data(const std::string& compressed_data) {
-    // Placeholder for actual decompression logic
-    std::string decompressed = compressed_data; // This would actually decompress the data
-    return decompressed;  // Return the decompressed data
-}
+private:
+    // Frames are written by compress_block()/compress_blockchain() while load_block() readers
+    // run in parallel; readers copy the frame pointer and decode outside the lock
+    mutable std::shared_mutex frames_mutex;
+    std::unordered_map<Hash256, std::shared_ptr<const std::string>, Hash256Hasher> compressed_blocks;  // Frames by block hash
+    std::vector<std::shared_ptr<const ArchiveReader>> archives;  // Sealed segments, oldest first (guarded by frames_mutex)
+    uint64_t archive_next;  // First height not archived yet (guarded by frames_mutex)
+    std::shared_ptr<ArchiveWriter> archive_writer;  // Open segment (nullptr = none)
+    uint64_t archive_fed;  // First height not fed to the open segment yet
+    std::shared_ptr<ThreadPool> pool;  // Created on the first parallel run
+
+    // Finish the open segment, if any, and publish it; archiving continues at next
+    size_t seal_open_archive(uint64_t next);
+
+    // Sealed segment holding a height (nullptr if none)
+    std::shared_ptr<const ArchiveReader> find_archive(uint64_t height) const;
+
+    // A settled block from wherever it still lives: the ring, the store or the compactor
+    std::shared_ptr<Block> history_block(uint64_t height) const {
+        if (std::shared_ptr<Block> block = blockchain->get_block(height)) {
+            return block;
+        }
+        return compactor ? compactor->load_height(height) : nullptr;
+    }
+
+    // Publish a block's frame and drop any stale decoded copy
+    void store_frame(const Hash256& hash, std::string frame) {
+        {
+            std::unique_lock<std::shared_mutex> lock(frames_mutex);
+            compressed_blocks[hash] = std::make_shared<const std::string>(std::move(frame));
+        }
+        cache.erase(hash);
+    }
+
+    // Encode and compress one block with the current dictionary
+    std::string encode_compressed(const Block& block) const {
+        return compress_block_data(BlockCodec::encode_block(block), dictionary.get());
+    }
+
+    // Decompress and decode one frame (nullptr if it is corrupt)
+    std::shared_ptr<Block> decode_compressed(const std::string& frame) const {
+        try {
+            return BlockCodec::decode_block(decompress_data(frame, &dictionaries));
+        } catch (const std::runtime_error& error) {
+            std::cerr << "Block decompression failed: " << error.what() << std::endl;
+            return nullptr;
+        }
+    }
+
+    // Run work(begin, end) over [0, count) split into contiguous shards, one per worker
+    template <typename Work>
+    void for_each_shard(size_t count, Work work) {
+        const size_t MIN_BLOCKS_PER_TASK = 16;
+        size_t task_count = std::min(max_workers, count / MIN_BLOCKS_PER_TASK);
+        if (task_count <= 1) {
+            work(0, count);
+            return;
+        }
+
+        if (!pool || pool->size() != max_workers) {
+            pool = std::make_shared<ThreadPool>(max_workers);
+        }
+        std::vector<std::future<void>> tasks;
+        size_t shard_size = (count + task_count - 1) / task_count;
+        for (size_t begin = 0; begin < count; begin += shard_size) {
+            size_t end = std::min(count, begin + shard_size);
+            tasks.push_back(pool->submit([&work, begin, end] { work(begin, end); }));
+        }
+        for (auto& task : tasks) {
+            task.get();
+        }
+    }
+};
 
 } // End of namespace Compcrypt
 
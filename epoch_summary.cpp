@@ -0,0 +1,233 @@
+#include "epoch_summary.h"
+#include "blockchain.h"
+#include "block_codec.h"
+#include "compression.h"
+
+EpochSummaryTree::EpochSummaryTree(uint64_t origin, uint32_t max_level)
+    : origin(origin), next(origin), max_level(max_level), total_bytes(0),
+      compressor(new Compcrypt::FrameCompressor()) {}
+
+EpochSummaryTree::~EpochSummaryTree() = default;
+
+// Index of the held summary containing height (summaries are contiguous, so this is a bisection)
+size_t EpochSummaryTree::locate(uint64_t height) const {
+    size_t low = 0;
+    size_t high = summaries.size();
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (summaries[middle].first_height <= height) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+bool EpochSummaryTree::append(const Block& block) {
+    if (block.index != next) {
+        return false;
+    }
+
+    std::string encoded = BlockCodec::encode_block(block);
+    std::string record;
+    record.reserve(BlockCodec::varint_size(encoded.size()) + encoded.size());
+    BlockCodec::put_varint(record, encoded.size());
+    record += encoded;
+    append_record(block.index, block.get_block_hash(), record);
+    return true;
+}
+
+void EpochSummaryTree::append_record(uint64_t height, const Hash256& hash, const std::string& record) {
+    EpochSummary leaf{height, 0, hash, compressor->compress(record)};
+    total_bytes += leaf.frame.size();
+    summaries.push_back(std::move(leaf));
+    next = height + 1;
+    start_merge(summaries.size() - 1);
+    advance_merges();
+}
+
+// A summary that is the right half of an aligned pair starts its parent. The children are
+// decompressed once up front (cheap next to deflating them); the codec follows the pair's
+// sampled entropy.
+void EpochSummaryTree::start_merge(size_t right) {
+    const EpochSummary& child = summaries[right];
+    uint32_t level = child.level;
+    if (level >= max_level || right == 0 || (((child.first_height - origin) >> level) & 1) == 0) {
+        return;
+    }
+    const EpochSummary& left = summaries[right - 1];
+    if (left.level != level || left.first_height + (1ull << level) != child.first_height) {
+        return;  // The left half was pruned or is still being merged
+    }
+
+    PendingMerge merge;
+    merge.first_height = left.first_height;
+    merge.level = level + 1;
+    merge.last_block_hash = child.last_block_hash;
+    merge.records = Compcrypt::decompress_data(left.frame);
+    merge.records += Compcrypt::decompress_data(child.frame);
+    merge.fed = 0;
+    // Finish within 2^level appends: the parent's sibling completes 2^(level+1) appends from now
+    merge.quota = std::max<size_t>(1, (merge.records.size() + (1ull << level) - 1) >> level);
+    merge.compressor.reset(new Compcrypt::FrameCompressor());
+    merge.compressor->begin(merge.frame, nullptr, Compcrypt::choose_codec(merge.records));
+    merges.push_back(std::move(merge));
+}
+
+// Feed every pending merge its slice; merges started by a completion are fed in the same pass
+void EpochSummaryTree::advance_merges() {
+    for (size_t i = 0; i < merges.size();) {
+        PendingMerge& merge = merges[i];
+        size_t size = std::min(merge.quota, merge.records.size() - merge.fed);
+        merge.compressor->update(merge.records.data() + merge.fed, size, merge.frame);
+        merge.fed += size;
+        if (merge.fed < merge.records.size()) {
+            i++;
+            continue;
+        }
+        PendingMerge done = std::move(merge);
+        merges.erase(merges.begin() + i);
+        complete_merge(done);
+    }
+}
+
+// Swap the finished parent in for its two children, then see whether it completes a pair itself
+void EpochSummaryTree::complete_merge(PendingMerge& merge) {
+    merge.compressor->finish(merge.frame);
+    if (summaries.empty() || merge.first_height < first_height()) {
+        return;
+    }
+    size_t left = locate(merge.first_height);
+    uint32_t child_level = merge.level - 1;
+    if (left + 1 >= summaries.size() || summaries[left].first_height != merge.first_height ||
+        summaries[left].level != child_level || summaries[left + 1].level != child_level) {
+        return;  // A child was dropped while the parent was being built
+    }
+
+    total_bytes -= summaries[left].frame.size() + summaries[left + 1].frame.size();
+    total_bytes += merge.frame.size();
+    summaries[left] = EpochSummary{merge.first_height, merge.level, merge.last_block_hash, std::move(merge.frame)};
+    summaries.erase(summaries.begin() + left + 1);
+    start_merge(left);
+}
+
+void EpochSummaryTree::truncate(uint64_t height) {
+    if (height >= next) {
+        return;
+    }
+    if (height <= first_height()) {
+        reset(height);
+        return;
+    }
+    merges.erase(std::remove_if(merges.begin(), merges.end(),
+                                [height](const PendingMerge& merge) {
+                                    return merge.first_height + (1ull << merge.level) > height;
+                                }),
+                 merges.end());
+    while (summaries.back().first_height >= height) {
+        total_bytes -= summaries.back().frame.size();
+        summaries.pop_back();
+    }
+    next = height;
+    if (summaries.back().first_height + (1ull << summaries.back().level) <= height) {
+        return;
+    }
+
+    // The newest summary straddles height: summarize its lower blocks again
+    EpochSummary straddling = std::move(summaries.back());
+    total_bytes -= straddling.frame.size();
+    summaries.pop_back();
+    next = straddling.first_height;
+    std::string records;
+    try {
+        records = Compcrypt::decompress_data(straddling.frame);
+    } catch (const std::runtime_error&) {
+        return;  // Keep what's below it; the caller refills from the chain
+    }
+    std::string_view data(records);
+    size_t pos = 0;
+    for (uint64_t block_height = straddling.first_height; block_height < height; block_height++) {
+        size_t start = pos;
+        uint64_t length = 0;
+        BlockCodec::BlockView view;
+        if (!BlockCodec::get_varint(data, pos, length) || length > data.size() - pos ||
+            !view.parse(data.substr(pos, length))) {
+            return;
+        }
+        pos += length;
+        append_record(block_height, Hash256::digest(view.header_bytes), records.substr(start, pos - start));
+    }
+}
+
+void EpochSummaryTree::prune_below(uint64_t height) {
+    while (!summaries.empty() && summaries.front().first_height + (1ull << summaries.front().level) <= height) {
+        total_bytes -= summaries.front().frame.size();
+        summaries.pop_front();
+    }
+    if (summaries.empty()) {
+        reset(next);
+        return;
+    }
+    uint64_t first = first_height();
+    merges.erase(std::remove_if(merges.begin(), merges.end(),
+                                [first](const PendingMerge& merge) { return merge.first_height < first; }),
+                 merges.end());
+}
+
+void EpochSummaryTree::reset(uint64_t new_origin) {
+    summaries.clear();
+    merges.clear();
+    origin = new_origin;
+    next = new_origin;
+    total_bytes = 0;
+}
+
+std::vector<const EpochSummary*> EpochSummaryTree::cover(uint64_t start, uint64_t end) const {
+    std::vector<const EpochSummary*> covering;
+    if (start >= end || start < first_height() || end > next) {
+        return covering;
+    }
+    for (size_t i = locate(start); i < summaries.size() && summaries[i].first_height < end; i++) {
+        covering.push_back(&summaries[i]);
+    }
+    return covering;
+}
+
+std::vector<std::shared_ptr<Block>> EpochSummaryTree::read_range(uint64_t start, uint64_t end) const {
+    std::vector<std::shared_ptr<Block>> blocks;
+    std::vector<const EpochSummary*> covering = cover(start, end);
+    if (covering.empty()) {
+        return blocks;
+    }
+    blocks.reserve(end - start);
+
+    for (const EpochSummary* summary : covering) {
+        std::string records;
+        try {
+            records = Compcrypt::decompress_data(summary->frame);
+        } catch (const std::runtime_error& error) {
+            std::cerr << "Epoch summary at height " << summary->first_height << " is corrupt: " << error.what() << std::endl;
+            return {};
+        }
+
+        // Blocks of the edge summaries outside the range are skipped without decoding
+        std::string_view data(records);
+        size_t pos = 0;
+        for (uint64_t height = summary->first_height; pos < data.size() && height < end; height++) {
+            uint64_t length = 0;
+            if (!BlockCodec::get_varint(data, pos, length) || length > data.size() - pos) {
+                return {};
+            }
+            if (height >= start) {
+                std::shared_ptr<Block> block = BlockCodec::decode_block(data.substr(pos, length));
+                if (!block) {
+                    return {};
+                }
+                blocks.push_back(std::move(block));
+            }
+            pos += length;
+        }
+    }
+    return blocks;
+}
@@ -0,0 +1,101 @@
+#ifndef EPOCH_SUMMARY_H
+#define EPOCH_SUMMARY_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "hash256.h"
+
+class Block;
+
+namespace Compcrypt {
+class FrameCompressor;
+}
+
+// One node of the summary tree: a single compressed frame holding 2^level consecutive
+// blocks, each stored as [varint length | encoded block].
+struct EpochSummary {
+    uint64_t first_height;     // Height of the first block covered
+    uint32_t level;            // Covers 2^level blocks
+    Hash256 last_block_hash;   // Hash of the last block covered (detects replaced tips)
+    std::string frame;         // Compcrypt frame of the concatenated block records
+};
+
+// Append-only segment tree of compressed epoch summaries, held as its frontier only.
+// Every block lives in exactly one held summary: whenever a summary completes an aligned pair,
+// the pair is merged into a summary one level up and the two children are dropped once the
+// parent is finished, so the tree takes O(n) space. Merges are incremental: a merge of two
+// 2^k-block children feeds 1/2^k of their records into the parent frame per append, so it
+// finishes well before its parent can pair up and no append pays for a whole high-level
+// merge. Any range is covered by O(log n) summaries (plus one per 2^max_level blocks for
+// ranges longer than the top level).
+class EpochSummaryTree {
+public:
+    explicit EpochSummaryTree(uint64_t origin = 0, uint32_t max_level = 12);
+    ~EpochSummaryTree();
+
+    EpochSummaryTree(const EpochSummaryTree&) = delete;
+    EpochSummaryTree& operator=(const EpochSummaryTree&) = delete;
+
+    // Summarize the block at next_height(); false if it's not the next height
+    bool append(const Block& block);
+
+    // Drop every block at or above height (the chain switched forks); a summary straddling
+    // height is split and its lower blocks are summarized again
+    void truncate(uint64_t height);
+
+    // Drop summaries that end at or below height (history no longer needed)
+    void prune_below(uint64_t height);
+
+    // Drop everything and start over at origin
+    void reset(uint64_t origin);
+
+    // The held summaries overlapping [start, end), in height order; the first and last may
+    // extend past the range (empty if part of the range isn't summarized)
+    std::vector<const EpochSummary*> cover(uint64_t start, uint64_t end) const;
+
+    // Decode blocks [start, end) from their covering summaries (empty on failure)
+    std::vector<std::shared_ptr<Block>> read_range(uint64_t start, uint64_t end) const;
+
+    // Newest summary, which always ends at next_height() - 1 (nullptr if empty)
+    const EpochSummary* back() const { return summaries.empty() ? nullptr : &summaries.back(); }
+
+    uint64_t first_height() const { return summaries.empty() ? next : summaries.front().first_height; }
+    uint64_t next_height() const { return next; }
+    bool empty() const { return summaries.empty(); }
+    size_t summary_count() const { return summaries.size(); }
+    size_t pending_merges() const { return merges.size(); }
+    size_t compressed_bytes() const { return total_bytes; }
+
+private:
+    // A parent frame being built from its two children's records, a slice per append
+    struct PendingMerge {
+        uint64_t first_height;
+        uint32_t level;            // Level of the parent
+        Hash256 last_block_hash;
+        std::string records;       // Children's records, back to back
+        size_t fed;                // Bytes of records already compressed
+        size_t quota;              // Bytes compressed per append
+        std::string frame;
+        std::unique_ptr<Compcrypt::FrameCompressor> compressor;
+    };
+
+    size_t locate(uint64_t height) const;
+    void append_record(uint64_t height, const Hash256& hash, const std::string& record);
+    void start_merge(size_t right);
+    void advance_merges();
+    void complete_merge(PendingMerge& merge);
+
+    std::deque<EpochSummary> summaries;  // Contiguous, non-overlapping, oldest first
+    std::vector<PendingMerge> merges;    // At most one per level
+    uint64_t origin;        // Height summaries are aligned to
+    uint64_t next;          // Height the next appended block must have
+    uint32_t max_level;
+    size_t total_bytes;     // Sum of all held frame sizes
+    std::unique_ptr<Compcrypt::FrameCompressor> compressor;  // Reused for leaf frames
+};
+
+#endif // EPOCH_SUMMARY_H
@@ -0,0 +1,127 @@
+#include "fork_tree.h"
+#include "blockchain.h"
+#include <algorithm>
+
+bool OrphanPool::add(std::shared_ptr<Block> block) {
+    const Hash256& hash = block->get_block_hash();
+    if (contains(hash) || block->encoded_size > max_bytes) {
+        return false;
+    }
+
+    // Evict the oldest orphans until the new one fits the budget
+    while (total_bytes + block->encoded_size > max_bytes && !arrival_order.empty()) {
+        remove(arrival_order.begin()->second);
+    }
+
+    uint64_t sequence = next_sequence++;
+    total_bytes += block->encoded_size;
+    by_parent[block->previous_hash].push_back(hash);
+    arrival_order.emplace(sequence, hash);
+    by_hash[hash] = Orphan{std::move(block), sequence};
+    return true;
+}
+
+std::vector<std::shared_ptr<Block>> OrphanPool::take_children(const Hash256& parent_hash) {
+    std::vector<std::shared_ptr<Block>> children;
+    auto it = by_parent.find(parent_hash);
+    if (it == by_parent.end()) {
+        return children;
+    }
+    std::vector<Hash256> child_hashes = std::move(it->second);
+    by_parent.erase(it);
+    for (const auto& child_hash : child_hashes) {
+        auto child = by_hash.find(child_hash);
+        if (child != by_hash.end()) {
+            total_bytes -= child->second.block->encoded_size;
+            arrival_order.erase(child->second.sequence);
+            children.push_back(std::move(child->second.block));
+            by_hash.erase(child);
+        }
+    }
+    return children;
+}
+
+void OrphanPool::prune_below(uint64_t height) {
+    std::vector<Hash256> stale;
+    for (const auto& entry : by_hash) {
+        if (entry.second.block->index <= height) {
+            stale.push_back(entry.first);
+        }
+    }
+    for (const auto& hash : stale) {
+        remove(hash);
+    }
+}
+
+void OrphanPool::remove(const Hash256& hash) {
+    auto it = by_hash.find(hash);
+    if (it == by_hash.end()) {
+        return;
+    }
+    auto siblings = by_parent.find(it->second.block->previous_hash);
+    if (siblings != by_parent.end()) {
+        std::vector<Hash256>& hashes = siblings->second;
+        hashes.erase(std::remove(hashes.begin(), hashes.end(), hash), hashes.end());
+        if (hashes.empty()) {
+            by_parent.erase(siblings);
+        }
+    }
+    total_bytes -= it->second.block->encoded_size;
+    arrival_order.erase(it->second.sequence);
+    by_hash.erase(it);
+}
+
+bool ForkTree::add(std::shared_ptr<Block> block) {
+    const Hash256 hash = block->get_block_hash();
+    if (contains(hash)) {
+        return false;
+    }
+    total_bytes += block->encoded_size;
+    by_height.emplace(block->index, hash);
+    blocks[hash] = std::move(block);
+
+    // Evict the lowest side blocks until the tree fits its budget again
+    while (total_bytes > max_bytes && !by_height.empty()) {
+        remove(Hash256(by_height.begin()->second));
+    }
+    return contains(hash);
+}
+
+void ForkTree::remove(const Hash256& hash) {
+    auto it = blocks.find(hash);
+    if (it == blocks.end()) {
+        return;
+    }
+    total_bytes -= it->second->encoded_size;
+    auto range = by_height.equal_range(it->second->index);
+    for (auto entry = range.first; entry != range.second; ++entry) {
+        if (entry->second == hash) {
+            by_height.erase(entry);
+            break;
+        }
+    }
+    blocks.erase(it);
+}
+
+std::shared_ptr<Block> ForkTree::get(const Hash256& hash) const {
+    auto it = blocks.find(hash);
+    return it == blocks.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<Block> ForkTree::best_tip() const {
+    if (by_height.empty()) {
+        return nullptr;
+    }
+    return get(std::prev(by_height.end())->second);
+}
+
+void ForkTree::prune_below(uint64_t height) {
+    while (!by_height.empty() && by_height.begin()->first <= height) {
+        auto it = blocks.find(by_height.begin()->second);
+        if (it != blocks.end()) {
+            total_bytes -= it->second->encoded_size;
+            blocks.erase(it);
+        }
+        by_height.erase(by_height.begin());
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef FORK_TREE_H
+#define FORK_TREE_H
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include "hash256.h"
+
+class Block;
+
+// Blocks whose parent hasn't arrived yet, keyed by the parent hash they wait for.
+// Memory is bounded by max_bytes of encoded block size; the oldest orphans are evicted first.
+class OrphanPool {
+public:
+    explicit OrphanPool(size_t max_bytes = 16 * 1024 * 1024) : max_bytes(max_bytes), total_bytes(0), next_sequence(0) {}
+
+    // Buffer an orphan; false if it's already buffered or larger than the whole budget
+    bool add(std::shared_ptr<Block> block);
+
+    // Remove and return every orphan waiting for this parent
+    std::vector<std::shared_ptr<Block>> take_children(const Hash256& parent_hash);
+
+    bool contains(const Hash256& hash) const { return by_hash.count(hash) > 0; }
+
+    // Drop orphans at or below a height (their parent can no longer be connected)
+    void prune_below(uint64_t height);
+
+    size_t size() const { return by_hash.size(); }
+    size_t bytes() const { return total_bytes; }
+
+private:
+    struct Orphan {
+        std::shared_ptr<Block> block;
+        uint64_t sequence;  // Key in arrival_order
+    };
+
+    void remove(const Hash256& hash);
+
+    size_t max_bytes;
+    size_t total_bytes;
+    uint64_t next_sequence;
+    std::unordered_map<Hash256, Orphan, Hash256Hasher> by_hash;
+    std::unordered_map<Hash256, std::vector<Hash256>, Hash256Hasher> by_parent;  // parent -> waiting children
+    std::map<uint64_t, Hash256> arrival_order;  // Arrival sequence -> orphan, oldest first; kept in sync with by_hash
+};
+
+// Side-branch blocks that connect to the held chain but not at its tip.
+// Kept by hash with a height index so the best side tip and stale branches are cheap to find.
+// Memory is bounded by max_bytes of encoded block size; the lowest side blocks (the deepest
+// forks, least likely to be switched to) are evicted first. A branch left without its base
+// is dropped when it is next considered for a switch.
+class ForkTree {
+public:
+    explicit ForkTree(size_t max_bytes = 64 * 1024 * 1024) : max_bytes(max_bytes), total_bytes(0) {}
+
+    // Hold a side block; false if it is already held or was evicted straight away by the budget
+    bool add(std::shared_ptr<Block> block);
+    void remove(const Hash256& hash);
+
+    bool contains(const Hash256& hash) const { return blocks.count(hash) > 0; }
+    std::shared_ptr<Block> get(const Hash256& hash) const;
+
+    // Highest side-branch block (nullptr if there are none)
+    std::shared_ptr<Block> best_tip() const;
+
+    // Drop side blocks at or below a height (they fork off below the held chain)
+    void prune_below(uint64_t height);
+
+    size_t size() const { return blocks.size(); }
+    size_t bytes() const { return total_bytes; }
+
+private:
+    size_t max_bytes;
+    size_t total_bytes;
+    std::unordered_map<Hash256, std::shared_ptr<Block>, Hash256Hasher> blocks;
+    std::multimap<uint64_t, Hash256> by_height;
+};
+
+#endif // FORK_TREE_H
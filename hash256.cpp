@@ -0,0 +1,17 @@
+#include "hash256.h"
+#include <openssl/sha.h>  // For SHA256
+
+Hash256 Hash256::digest(std::string_view data) {
+    Hash256 hash;
+    SHA256(reinterpret_cast<const unsigned char*>(data.data()), data.size(), hash.bytes.data());
+    return hash;
+}
+
+Hash256 Hash256::combine(const Hash256& left, const Hash256& right) {
+    unsigned char pair[64];
+    std::memcpy(pair, left.bytes.data(), 32);
+    std::memcpy(pair + 32, right.bytes.data(), 32);
+    Hash256 hash;
+    SHA256(pair, sizeof(pair), hash.bytes.data());
+    return hash;
+}
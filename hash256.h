@@ -0,0 +1,107 @@
+#ifndef HASH256_H
+#define HASH256_H
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+// Fixed-width 32-byte hash value (block hashes, Merkle nodes, transaction ids).
+// Trivially copyable; hex is only produced or parsed at the edges (logs, RPC, config).
+struct Hash256 {
+    std::array<uint8_t, 32> bytes{};
+
+    // SHA-256 of the data (implemented in hash256.cpp with OpenSSL)
+    static Hash256 digest(std::string_view data);
+
+    // SHA-256 of two hashes back to back (Merkle parent node)
+    static Hash256 combine(const Hash256& left, const Hash256& right);
+
+    constexpr bool is_zero() const {
+        for (uint8_t byte : bytes) {
+            if (byte != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool operator==(const Hash256& other) const {
+        for (size_t i = 0; i < bytes.size(); ++i) {
+            if (bytes[i] != other.bytes[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool operator!=(const Hash256& other) const {
+        return !(*this == other);
+    }
+
+    // Lexicographic order (for ordered containers and deterministic tie-breaks)
+    bool operator<(const Hash256& other) const {
+        return std::memcmp(bytes.data(), other.bytes.data(), bytes.size()) < 0;
+    }
+
+    // Lowercase hex encoding as a fixed-size character array
+    constexpr std::array<char, 64> to_hex_chars() const {
+        constexpr char digits[] = "0123456789abcdef";
+        std::array<char, 64> hex{};
+        for (size_t i = 0; i < bytes.size(); ++i) {
+            hex[2 * i] = digits[bytes[i] >> 4];
+            hex[2 * i + 1] = digits[bytes[i] & 0x0f];
+        }
+        return hex;
+    }
+
+    std::string to_hex() const {
+        std::array<char, 64> hex = to_hex_chars();
+        return std::string(hex.data(), hex.size());
+    }
+
+    // Parse 64 hex characters; returns false (and leaves out untouched) on bad input
+    static constexpr bool from_hex(std::string_view hex, Hash256& out) {
+        if (hex.size() != 64) {
+            return false;
+        }
+        Hash256 parsed{};
+        for (size_t i = 0; i < 32; ++i) {
+            int high = hex_value(hex[2 * i]);
+            int low = hex_value(hex[2 * i + 1]);
+            if (high < 0 || low < 0) {
+                return false;
+            }
+            parsed.bytes[i] = static_cast<uint8_t>((high << 4) | low);
+        }
+        out = parsed;
+        return true;
+    }
+
+private:
+    static constexpr int hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+};
+
+// Hasher for unordered containers: the value is already a uniform hash, so take its first word
+struct Hash256Hasher {
+    size_t operator()(const Hash256& hash) const noexcept {
+        size_t value;
+        std::memcpy(&value, hash.bytes.data(), sizeof(value));
+        return value;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& out, const Hash256& hash) {
+    std::array<char, 64> hex = hash.to_hex_chars();
+    return out.write(hex.data(), hex.size());
+}
+
+#endif // HASH256_H
@@ -0,0 +1,152 @@
+#include "ingress_pipeline.h"
+#include "transaction.h"
+#include "block_codec.h"
+#include "transaction_pool.h"
+#include "snark_proof_validator.h"
+#include <iostream>
+
+IngressPipeline::IngressPipeline(TransactionPool& pool, IngressConfig config)
+    : pool(pool), config(config), ingress(config.queue_capacity), to_sign_check(config.queue_capacity),
+      to_prove(config.queue_capacity), to_insert(config.queue_capacity), decoders_running(0), signature_running(0),
+      proof_running(0), inserters_running(0), submitted(0), refused(0), bad_encoding(0), bad_signature(0), bad_proof(0),
+      rejected(0), inserted(0), proof_batches(0) {
+    this->config.proof_batch = std::max<size_t>(1, config.proof_batch);
+    this->config.insert_batch = std::max<size_t>(1, config.insert_batch);
+    if (!this->config.check_signature) {
+        std::cerr << "Ingress pipeline has no signature check; every transaction will be rejected." << std::endl;
+    }
+    start_stage(std::max<size_t>(1, config.decode_workers), &IngressPipeline::decode_loop, &to_sign_check, decoders_running);
+    start_stage(std::max<size_t>(1, config.signature_workers), &IngressPipeline::signature_loop, &to_prove, signature_running);
+    start_stage(std::max<size_t>(1, config.proof_workers), &IngressPipeline::proof_loop, &to_insert, proof_running);
+    start_stage(std::max<size_t>(1, config.insert_workers), &IngressPipeline::insert_loop, nullptr, inserters_running);
+}
+
+IngressPipeline::~IngressPipeline() {
+    stop();
+}
+
+void IngressPipeline::start_stage(size_t count, void (IngressPipeline::*loop)(), BoundedQueue<Decoded>* next,
+                                  std::atomic<size_t>& running) {
+    running.store(count);
+    for (size_t i = 0; i < count; i++) {
+        workers.emplace_back([this, loop, next, &running] {
+            (this->*loop)();
+            // The stage's input is closed and drained: once every worker is done, so is its output
+            if (running.fetch_sub(1) == 1 && next != nullptr) {
+                next->close();
+            }
+        });
+    }
+}
+
+bool IngressPipeline::try_submit(IngressItem item) {
+    if (!ingress.try_push(item)) {
+        refused++;
+        return false;
+    }
+    submitted++;
+    return true;
+}
+
+bool IngressPipeline::submit(IngressItem item) {
+    if (!ingress.push(std::move(item))) {
+        return false;
+    }
+    submitted++;
+    return true;
+}
+
+void IngressPipeline::stop() {
+    ingress.close();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+size_t IngressPipeline::pending() const {
+    return ingress.size() + to_sign_check.size() + to_prove.size() + to_insert.size();
+}
+
+// Parse the canonical encoding; the transaction's digest and size are computed here, once
+void IngressPipeline::decode_loop() {
+    std::vector<IngressItem> batch;
+    while (ingress.pop_batch(batch, config.insert_batch) > 0) {
+        for (auto& item : batch) {
+            BlockCodec::TransactionView view;
+            size_t pos = 0;
+            if (!view.parse(item.encoded, pos) || pos != item.encoded.size()) {
+                bad_encoding++;
+                continue;
+            }
+            to_sign_check.push(Decoded{BlockCodec::decode_transaction(view), item.fee, std::move(item.signature)});
+        }
+        batch.clear();
+    }
+}
+
+void IngressPipeline::signature_loop() {
+    std::vector<Decoded> batch;
+    while (to_sign_check.pop_batch(batch, config.proof_batch) > 0) {
+        for (auto& decoded : batch) {
+            if (!config.check_signature || !config.check_signature(*decoded.tx, decoded.signature)) {
+                bad_signature++;
+                continue;
+            }
+            to_prove.push(std::move(decoded));
+        }
+        batch.clear();
+    }
+}
+
+// One validator per worker, reused for every batch it verifies
+void IngressPipeline::proof_loop() {
+    SnarkProofValidator validator;
+    std::vector<Decoded> batch;
+    std::vector<std::string_view> proofs;
+    std::vector<bool> valid;
+    while (to_prove.pop_batch(batch, config.proof_batch) > 0) {
+        proofs.clear();
+        for (const auto& decoded : batch) {
+            proofs.push_back(decoded.tx->snark_proof);
+        }
+        validator.validateBatch(proofs, valid);
+        proof_batches++;
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (!valid[i]) {
+                bad_proof++;
+                continue;
+            }
+            to_insert.push(std::move(batch[i]));
+        }
+        batch.clear();
+    }
+}
+
+void IngressPipeline::insert_loop() {
+    std::vector<Decoded> batch;
+    while (to_insert.pop_batch(batch, config.insert_batch) > 0) {
+        for (auto& decoded : batch) {
+            if (pool.insertVerifiedTransaction(std::move(decoded.tx), decoded.fee, std::move(decoded.signature))) {
+                inserted++;
+            } else {
+                rejected++;
+            }
+        }
+        batch.clear();
+    }
+}
+
+IngressStats IngressPipeline::get_stats() const {
+    IngressStats stats;
+    stats.submitted = submitted.load();
+    stats.refused = refused.load();
+    stats.bad_encoding = bad_encoding.load();
+    stats.bad_signature = bad_signature.load();
+    stats.bad_proof = bad_proof.load();
+    stats.rejected = rejected.load();
+    stats.inserted = inserted.load();
+    stats.proof_batches = proof_batches.load();
+    return stats;
+}
@@ -0,0 +1,121 @@
+#ifndef INGRESS_PIPELINE_H
+#define INGRESS_PIPELINE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include "bounded_queue.h"
+
+class Transaction;
+class TransactionPool;
+
+// A transaction as received from the network
+struct IngressItem {
+    std::string encoded;     // Canonical transaction encoding (see block_codec.h)
+    uint64_t fee = 0;
+    std::string signature;
+};
+
+// Pipeline sizing and hooks
+struct IngressConfig {
+    size_t queue_capacity = 4096;   // Per stage; a full ingress queue rejects try_submit()
+    size_t decode_workers = std::max(1u, std::thread::hardware_concurrency() / 4);
+    size_t signature_workers = std::max(1u, std::thread::hardware_concurrency() / 2);
+    size_t proof_workers = std::max(1u, std::thread::hardware_concurrency());
+    size_t insert_workers = std::max(1u, std::thread::hardware_concurrency() / 4);
+    size_t proof_batch = 64;        // Proofs handed to a validator per call
+    size_t insert_batch = 256;      // Transactions inserted per wakeup of the insert stage
+    // Signature check. Without one every transaction fails the signature stage: a pipeline
+    // that forgot to install its verifier must not admit unsigned transactions.
+    std::function<bool(const Transaction&, const std::string&)> check_signature;
+};
+
+// Counters reported by IngressPipeline::get_stats()
+struct IngressStats {
+    uint64_t submitted = 0;
+    uint64_t refused = 0;            // try_submit() calls turned away by a full queue
+    uint64_t bad_encoding = 0;
+    uint64_t bad_signature = 0;
+    uint64_t bad_proof = 0;
+    uint64_t rejected = 0;           // Already pooled, or refused by the pool's limits
+    uint64_t inserted = 0;
+    uint64_t proof_batches = 0;
+};
+
+// Staged ingest in front of the TransactionPool:
+//
+//   submit -> [decode] x D -> [signature] x N -> [proof, batched] x M -> [insert] x I -> pool
+//
+// Stages are connected by bounded queues. When verification falls behind, the queues fill
+// back to the ingress queue, where try_submit() fails instead of blocking the network
+// thread; submit() waits for room instead. Each proof worker owns one validator and checks
+// proofs in batches, so validator setup is paid once per worker, not once per transaction.
+// Inserters write to the pool concurrently; it is sharded by sender, so they rarely meet.
+class IngressPipeline {
+public:
+    IngressPipeline(TransactionPool& pool, IngressConfig config = IngressConfig());
+    ~IngressPipeline();
+
+    IngressPipeline(const IngressPipeline&) = delete;
+    IngressPipeline& operator=(const IngressPipeline&) = delete;
+
+    // Queue a transaction without waiting; false if the pipeline is full (or stopped)
+    bool try_submit(IngressItem item);
+
+    // Queue a transaction, waiting while the pipeline is full; false once stopped
+    bool submit(IngressItem item);
+
+    // Stop accepting input, let every queued transaction finish, and join the workers
+    void stop();
+
+    // Transactions queued between stages
+    size_t pending() const;
+
+    IngressStats get_stats() const;
+
+private:
+    struct Decoded {
+        std::shared_ptr<const Transaction> tx;
+        uint64_t fee;
+        std::string signature;
+    };
+
+    void decode_loop();
+    void signature_loop();
+    void proof_loop();
+    void insert_loop();
+
+    // Start count workers running loop; the last one to finish closes next (if any)
+    void start_stage(size_t count, void (IngressPipeline::*loop)(), BoundedQueue<Decoded>* next, std::atomic<size_t>& running);
+
+    TransactionPool& pool;
+    IngressConfig config;
+
+    BoundedQueue<IngressItem> ingress;
+    BoundedQueue<Decoded> to_sign_check;
+    BoundedQueue<Decoded> to_prove;
+    BoundedQueue<Decoded> to_insert;
+
+    std::atomic<size_t> decoders_running;
+    std::atomic<size_t> signature_running;
+    std::atomic<size_t> proof_running;
+    std::atomic<size_t> inserters_running;
+    std::vector<std::thread> workers;
+
+    std::atomic<uint64_t> submitted;
+    std::atomic<uint64_t> refused;
+    std::atomic<uint64_t> bad_encoding;
+    std::atomic<uint64_t> bad_signature;
+    std::atomic<uint64_t> bad_proof;
+    std::atomic<uint64_t> rejected;
+    std::atomic<uint64_t> inserted;
+    std::atomic<uint64_t> proof_batches;
+};
+
+#endif // INGRESS_PIPELINE_H
@@ -0,0 +1,222 @@
+#include "ledger_state.h"
+#include "blockchain.h"
+#include <functional>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+#include <fstream>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const uint64_t CHECKPOINT_MAGIC = 0x31544b43474c5250ull;  // "PRLGCKT1"
+
+// Smallest account record: u32 address length, an empty address, f64 balance
+const uint64_t MIN_ACCOUNT_RECORD = sizeof(uint32_t) + sizeof(double);
+
+template <typename T>
+void write_raw(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool read_raw(std::ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+// Saturates at the largest power of two a size_t holds
+size_t round_up_power_of_two(size_t value) {
+    const size_t largest = ~(SIZE_MAX >> 1);
+    size_t capacity = 16;
+    while (capacity < value && capacity < largest) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+} // namespace
+
+LedgerState::LedgerState(size_t initial_capacity)
+    : slots(round_up_power_of_two(initial_capacity)), used(0) {}
+
+size_t LedgerState::find_slot(std::string_view address) const {
+    size_t mask = slots.size() - 1;
+    size_t slot = std::hash<std::string_view>{}(address) & mask;
+    while (slots[slot].occupied && slots[slot].address != address) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+LedgerState::Slot& LedgerState::get_or_insert(std::string_view address) {
+    size_t slot = find_slot(address);
+    if (!slots[slot].occupied) {
+        // Keep the load factor under 0.7 so probe sequences stay short
+        if ((used + 1) * 10 > slots.size() * 7) {
+            grow();
+            slot = find_slot(address);
+        }
+        slots[slot].occupied = true;
+        slots[slot].address = std::string(address);
+        slots[slot].balance = 0;
+        used++;
+    }
+    return slots[slot];
+}
+
+void LedgerState::grow() {
+    std::vector<Slot> old_slots(slots.size() * 2);
+    old_slots.swap(slots);
+    for (auto& old_slot : old_slots) {
+        if (old_slot.occupied) {
+            slots[find_slot(old_slot.address)] = std::move(old_slot);
+        }
+    }
+}
+
+double LedgerState::get_balance(std::string_view address) const {
+    const Slot& slot = slots[find_slot(address)];
+    return slot.occupied ? slot.balance : 0;
+}
+
+bool LedgerState::can_apply(const Block& block) const {
+    // Net outflow per sender within the block, so several spends by one sender are checked together
+    std::unordered_map<std::string_view, double> outflow;
+    for (const auto& tx : block.transactions) {
+        if (!std::isfinite(tx.amount) || tx.amount < 0) {
+            return false;
+        }
+        outflow[tx.sender] += tx.amount;
+        outflow[tx.receiver] -= tx.amount;
+    }
+    for (const auto& entry : outflow) {
+        if (entry.second > 0 && get_balance(entry.first) < entry.second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LedgerState::apply_block(const Block& block) {
+    BlockUndo undo{block.index, {}};
+    std::unordered_set<std::string_view> touched;
+
+    auto remember = [&](std::string_view address) {
+        if (touched.insert(address).second) {
+            undo.previous.emplace_back(std::string(address), get_balance(address));
+        }
+    };
+
+    for (const auto& tx : block.transactions) {
+        remember(tx.sender);
+        remember(tx.receiver);
+        get_or_insert(tx.sender).balance -= tx.amount;
+        get_or_insert(tx.receiver).balance += tx.amount;
+    }
+    undo_log.push_back(std::move(undo));
+}
+
+bool LedgerState::undo_block(uint64_t height) {
+    if (undo_log.empty() || undo_log.back().height != height) {
+        return false;
+    }
+    for (const auto& entry : undo_log.back().previous) {
+        get_or_insert(entry.first).balance = entry.second;
+    }
+    undo_log.pop_back();
+    return true;
+}
+
+void LedgerState::discard_undo(uint64_t height) {
+    while (!undo_log.empty() && undo_log.front().height <= height) {
+        undo_log.pop_front();
+    }
+}
+
+void LedgerState::credit(std::string_view address, double amount) {
+    get_or_insert(address).balance += amount;
+}
+
+bool LedgerState::save_checkpoint(const std::string& path, uint64_t height, const Hash256& block_hash) const {
+    // Oldest undo record wins, so each touched account gets its balance from before the first rolled-back block
+    std::unordered_map<std::string_view, double> rolled_back;
+    for (auto it = undo_log.rbegin(); it != undo_log.rend() && it->height > height; ++it) {
+        for (const auto& entry : it->previous) {
+            rolled_back[entry.first] = entry.second;
+        }
+    }
+
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        write_raw(out, CHECKPOINT_MAGIC);
+        write_raw(out, height);
+        out.write(reinterpret_cast<const char*>(block_hash.bytes.data()), block_hash.bytes.size());
+        write_raw(out, static_cast<uint64_t>(used));
+        for (const auto& slot : slots) {
+            if (!slot.occupied) {
+                continue;
+            }
+            auto rolled = rolled_back.find(slot.address);
+            double balance = rolled == rolled_back.end() ? slot.balance : rolled->second;
+            write_raw(out, static_cast<uint32_t>(slot.address.size()));
+            out.write(slot.address.data(), slot.address.size());
+            write_raw(out, balance);
+        }
+        out.flush();
+        if (!out) {
+            return false;
+        }
+    }
+    // Replace the previous checkpoint only once the new one is complete and on disk
+    int fd = ::open(temporary.c_str(), O_WRONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced && std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+// Counts and lengths are checked against the bytes left in the file before anything is sized
+// from them, so a torn or foreign checkpoint fails here and the caller falls back to a replay
+bool LedgerState::load_checkpoint(const std::string& path, uint64_t& height, Hash256& block_hash) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return false;
+    }
+    uint64_t remaining = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+    uint64_t magic = 0;
+    uint64_t count = 0;
+    if (!read_raw(in, magic) || magic != CHECKPOINT_MAGIC || !read_raw(in, height) ||
+        !in.read(reinterpret_cast<char*>(block_hash.bytes.data()), block_hash.bytes.size()) || !read_raw(in, count)) {
+        return false;
+    }
+    remaining -= sizeof(magic) + sizeof(height) + block_hash.bytes.size() + sizeof(count);
+    if (count > remaining / MIN_ACCOUNT_RECORD) {
+        return false;
+    }
+
+    LedgerState loaded(count * 2);
+    for (uint64_t i = 0; i < count; i++) {
+        uint32_t length = 0;
+        double balance = 0;
+        if (!read_raw(in, length) || remaining < MIN_ACCOUNT_RECORD || length > remaining - MIN_ACCOUNT_RECORD) {
+            return false;
+        }
+        remaining -= MIN_ACCOUNT_RECORD + length;
+        std::string address(length, '\0');
+        if (!in.read(&address[0], length) || !read_raw(in, balance)) {
+            return false;
+        }
+        loaded.get_or_insert(address).balance = balance;
+    }
+    *this = std::move(loaded);
+    return true;
+}
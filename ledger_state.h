@@ -0,0 +1,72 @@
+#ifndef LEDGER_STATE_H
+#define LEDGER_STATE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include "hash256.h"
+
+class Block;
+
+// Materialized account balances, updated by applying each block as a delta.
+// Balances live in a flat open-addressing table (linear probing) so lookups are O(1)
+// without per-node allocations. Every applied block leaves an undo record holding the
+// previous balance of each account it touched, so the newest blocks can be unapplied
+// (fork switches) without replaying the chain.
+class LedgerState {
+public:
+    explicit LedgerState(size_t initial_capacity = 1024);
+
+    // Current balance of an address (0 if it has never been touched)
+    double get_balance(std::string_view address) const;
+
+    // Check that no sender would go negative and no amount is negative; O(transactions in block)
+    bool can_apply(const Block& block) const;
+
+    // Apply the block's transfers and record its undo entry
+    void apply_block(const Block& block);
+
+    // Unapply the most recently applied block; false if height isn't the newest applied block
+    bool undo_block(uint64_t height);
+
+    // Forget undo records up to and including height (those blocks are final, e.g. pruned)
+    void discard_undo(uint64_t height);
+
+    // Write the balances as of block height (newer blocks still in the undo log are rolled back in
+    // the written image) to path, atomically; block_hash identifies that block. O(accounts).
+    bool save_checkpoint(const std::string& path, uint64_t height, const Hash256& block_hash) const;
+
+    // Replace the state with a checkpoint written by save_checkpoint(); the undo log starts empty
+    bool load_checkpoint(const std::string& path, uint64_t& height, Hash256& block_hash);
+
+    // Credit an address outside of any block (genesis allocation, rewards); not undoable
+    void credit(std::string_view address, double amount);
+
+    size_t account_count() const { return used; }
+
+private:
+    struct Slot {
+        std::string address;
+        double balance = 0;
+        bool occupied = false;
+    };
+
+    struct BlockUndo {
+        uint64_t height;
+        std::vector<std::pair<std::string, double>> previous;  // Balance of each touched account before the block
+    };
+
+    size_t find_slot(std::string_view address) const;      // Slot holding address, or the empty slot where it belongs
+    Slot& get_or_insert(std::string_view address);
+    void grow();
+
+    std::vector<Slot> slots;          // Capacity is always a power of two
+    size_t used;                      // Occupied slots
+    std::deque<BlockUndo> undo_log;   // Oldest first
+};
+
+#endif // LEDGER_STATE_H
@@ -0,0 +1,120 @@
+#ifndef MERKLE_H
+#define MERKLE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "hash256.h"
+
+// Merkle tree helpers used to commit a block to its transaction digests. Leaves and inner
+// nodes are hashed under different one-byte tags, so a pair of digests can never pass for a
+// leaf. An odd last node is paired with itself; a list whose own last two nodes are equal at
+// any level would then share its root with a shorter one, so such lists count as mutated
+// (the CVE-2012-2459 pattern) and blocks carrying them are rejected.
+namespace Merkle {
+
+    const uint8_t LEAF_TAG = 0x00;
+    const uint8_t NODE_TAG = 0x01;
+
+    // One step of an inclusion proof: the sibling digest and which side it sits on
+    struct ProofStep {
+        Hash256 sibling;         // Digest of the sibling node at this level
+        bool sibling_on_left;    // True if the sibling is the left operand of the pair hash
+    };
+
+    // Hash a transaction digest into its leaf node
+    inline Hash256 hash_leaf(const Hash256& digest) {
+        char buffer[1 + 32];
+        buffer[0] = static_cast<char>(LEAF_TAG);
+        std::memcpy(buffer + 1, digest.bytes.data(), 32);
+        return Hash256::digest(std::string_view(buffer, sizeof(buffer)));
+    }
+
+    // Hash two child nodes into their parent node
+    inline Hash256 hash_pair(const Hash256& left, const Hash256& right) {
+        char buffer[1 + 64];
+        buffer[0] = static_cast<char>(NODE_TAG);
+        std::memcpy(buffer + 1, left.bytes.data(), 32);
+        std::memcpy(buffer + 33, right.bytes.data(), 32);
+        return Hash256::digest(std::string_view(buffer, sizeof(buffer)));
+    }
+
+    // Root committed to by a block without transactions
+    inline Hash256 empty_root() {
+        return Hash256::digest(std::string_view());
+    }
+
+    // Tagged leaf nodes for a list of transaction digests
+    inline std::vector<Hash256> leaf_level(const std::vector<Hash256>& digests) {
+        std::vector<Hash256> level;
+        level.reserve(digests.size());
+        for (const Hash256& digest : digests) {
+            level.push_back(hash_leaf(digest));
+        }
+        return level;
+    }
+
+    // Reduce one level of the tree (an odd last node is paired with itself). Sets mutated if
+    // the level ends in two equal nodes.
+    inline std::vector<Hash256> next_level(const std::vector<Hash256>& level, bool* mutated = nullptr) {
+        std::vector<Hash256> parents;
+        parents.reserve((level.size() + 1) / 2);
+        for (size_t i = 0; i < level.size(); i += 2) {
+            const Hash256& right = (i + 1 < level.size()) ? level[i + 1] : level[i];
+            parents.push_back(hash_pair(level[i], right));
+        }
+        if (mutated != nullptr && level.size() >= 2 && level.size() % 2 == 0 && level[level.size() - 2] == level.back()) {
+            *mutated = true;
+        }
+        return parents;
+    }
+
+    // Compute the Merkle root over a list of transaction digests. If mutated is given it is set
+    // when the list collides with a shorter one (see above).
+    inline Hash256 compute_root(const std::vector<Hash256>& digests, bool* mutated = nullptr) {
+        if (mutated != nullptr) {
+            *mutated = false;
+        }
+        if (digests.empty()) {
+            return empty_root();
+        }
+        std::vector<Hash256> level = leaf_level(digests);
+        while (level.size() > 1) {
+            level = next_level(level, mutated);
+        }
+        return level.front();
+    }
+
+    // Build the inclusion proof for the transaction digest at the given position
+    inline std::vector<ProofStep> build_proof(const std::vector<Hash256>& digests, size_t position) {
+        std::vector<ProofStep> proof;
+        if (position >= digests.size()) {
+            return proof;
+        }
+        std::vector<Hash256> level = leaf_level(digests);
+        while (level.size() > 1) {
+            size_t sibling = (position % 2 == 0) ? position + 1 : position - 1;
+            if (sibling >= level.size()) {
+                sibling = position;  // Odd last node is paired with itself
+            }
+            proof.push_back({level[sibling], sibling < position});
+            level = next_level(level);
+            position /= 2;
+        }
+        return proof;
+    }
+
+    // Check that a transaction digest is committed to by the given root
+    inline bool verify_proof(const Hash256& digest, const std::vector<ProofStep>& proof, const Hash256& root) {
+        Hash256 node = hash_leaf(digest);
+        for (const auto& step : proof) {
+            node = step.sibling_on_left ? hash_pair(step.sibling, node) : hash_pair(node, step.sibling);
+        }
+        return node == root;
+    }
+
+} // End of namespace Merkle
+
+#endif // MERKLE_H
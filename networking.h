@@ -10,10 +10,12 @@
 #include <thread>
 #include <atomic>
 #include <functional>
+#include "block_codec.h"
+#include "hash256.h"
+#include "transaction.h"
+#include "blockchain.h"
 
 // Forward declarations
-class Transaction;
-class Block;
 class Node;
 class Message;
 
@@ -46,11 +48,26 @@ namespace Networking {
         std::string content;     // The actual content of the message (e.g., transaction data)
         std::string sender_id;   // ID of the node sending the message
         std::string recipient_id; // ID of the intended recipient node
+        Hash256 object_hash;      // Hash of the block/transaction carried or requested (used for dedup and lookups)
 
-        Message(MessageType t, const std::string& c, const std::string& sender, const std::string& recipient)
-            : type(t), content(c), sender_id(sender), recipient_id(recipient) {}
+        Message(MessageType t, const std::string& c, const std::string& sender, const std::string& recipient, const Hash256& hash = Hash256{})
+            : type(t), content(c), sender_id(sender), recipient_id(recipient), object_hash(hash) {}
     };
 
+    // Build gossip messages whose content is the canonical binary encoding (see block_codec.h)
+    inline Message make_block_message(const Block& block, const std::string& sender, const std::string& recipient) {
+        return Message(MessageType::BLOCK, BlockCodec::encode_block(block), sender, recipient, block.get_block_hash());
+    }
+
+    inline Message make_transaction_message(const Transaction& tx, const std::string& sender, const std::string& recipient) {
+        return Message(MessageType::TRANSACTION, BlockCodec::encode_transaction(tx), sender, recipient, tx.get_digest());
+    }
+
+    // Ask a peer for a block by hash
+    inline Message make_block_request(const Hash256& block_hash, const std::string& sender, const std::string& recipient) {
+        return Message(MessageType::REQUEST_BLOCK, std::string(), sender, recipient, block_hash);
+    }
+
     // The networking interface for the node
     class INetworkingLayer {
     public:
@@ -0,0 +1,57 @@
+#ifndef TRANSACTION_H
+#define TRANSACTION_H
+
+#include <string>
+#include <cstdint>
+#include <ctime>
+#include "block_codec.h"
+#include "hash256.h"
+
+// Transaction class for representing a transaction in the blockchain
+class Transaction {
+public:
+    std::string sender;
+    std::string receiver;
+    double amount;
+    uint64_t timestamp;  // Timestamp for when the transaction was created
+    std::string snark_proof;  // Placeholder for SNARK proof
+
+    Transaction(std::string s, std::string r, double amt, std::string proof)
+        : sender(s), receiver(r), amount(amt), timestamp(std::time(nullptr)), snark_proof(proof) {
+            this->encoded_size = BlockCodec::encoded_size(*this);
+            this->digest = compute_digest();
+        }
+
+    // Constructor for restoring a stored transaction (keeps the original timestamp)
+    Transaction(std::string s, std::string r, double amt, uint64_t ts, std::string proof)
+        : sender(s), receiver(r), amount(amt), timestamp(ts), snark_proof(proof) {
+            this->encoded_size = BlockCodec::encoded_size(*this);
+            this->digest = compute_digest();
+        }
+
+    // Function to get the transaction data: its canonical binary encoding (see block_codec.h)
+    std::string get_transaction_data() const {
+        return BlockCodec::encode_transaction(*this);
+    }
+
+    // Exact encoded size in bytes, computed once at construction
+    size_t get_encoded_size() const {
+        return encoded_size;
+    }
+
+    // Digest of the transaction data, computed once at construction (Merkle leaf of the block)
+    const Hash256& get_digest() const {
+        return digest;
+    }
+
+    // Recompute the digest from the current fields (used to detect tampering)
+    Hash256 compute_digest() const {
+        return Hash256::digest(get_transaction_data());
+    }
+
+private:
+    Hash256 digest;  // Cached digest of get_transaction_data()
+    size_t encoded_size;  // Cached size of get_transaction_data()
+};
+
+#endif // TRANSACTION_H
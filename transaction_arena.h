@@ -0,0 +1,133 @@
+#ifndef TRANSACTION_ARENA_H
+#define TRANSACTION_ARENA_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iterator>
+#include <cstdint>
+#include <cstddef>
+#include "transaction.h"
+#include "block_codec.h"
+#include "hash256.h"
+
+// Block-owned flat storage for transactions.
+// Every transaction is kept in its canonical encoding inside one contiguous buffer, so a
+// block costs a handful of allocations instead of one heap object and refcount per
+// transaction, and validation walks memory linearly. Readers get zero-copy TransactionViews.
+// Arenas are move-only: a builder (e.g. the block template) can fill one and hand it to a
+// Block without copying any transaction bytes.
+class TransactionArena {
+public:
+    TransactionArena() = default;
+    TransactionArena(TransactionArena&&) = default;
+    TransactionArena& operator=(TransactionArena&&) = default;
+    TransactionArena(const TransactionArena&) = delete;
+    TransactionArena& operator=(const TransactionArena&) = delete;
+
+    // Reserve room up front so filling the arena doesn't reallocate
+    void reserve(size_t transaction_count, size_t byte_count) {
+        entries.reserve(transaction_count);
+        digests.reserve(transaction_count);
+        bytes.reserve(byte_count);
+    }
+
+    // Encode a transaction into the arena (reuses its cached digest)
+    void append(const Transaction& tx) {
+        size_t offset = bytes.size();
+        BlockCodec::encode_transaction(tx, bytes);
+        entries.push_back({static_cast<uint32_t>(offset), static_cast<uint32_t>(bytes.size() - offset)});
+        digests.push_back(tx.get_digest());
+    }
+
+    // Copy an encoding already known to parse, whose digest is known (e.g. a pooled transaction)
+    void append_encoded(std::string_view encoded, const Hash256& digest) {
+        size_t offset = bytes.size();
+        bytes.append(encoded.data(), encoded.size());
+        entries.push_back({static_cast<uint32_t>(offset), static_cast<uint32_t>(encoded.size())});
+        digests.push_back(digest);
+    }
+
+    // Copy an already encoded transaction into the arena; returns false if it doesn't parse
+    bool append_encoded(std::string_view encoded) {
+        BlockCodec::TransactionView view;
+        size_t pos = 0;
+        if (!view.parse(encoded, pos) || pos != encoded.size()) {
+            return false;
+        }
+        size_t offset = bytes.size();
+        bytes.append(encoded.data(), encoded.size());
+        entries.push_back({static_cast<uint32_t>(offset), static_cast<uint32_t>(encoded.size())});
+        digests.push_back(compute_digest(encoded));
+        return true;
+    }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+    // Total encoded size of all transactions
+    size_t byte_size() const { return bytes.size(); }
+
+    // All encoded transactions back to back (the transaction section of an encoded block)
+    std::string_view encoded_bytes() const {
+        return bytes;
+    }
+
+    // Encoded bytes of one transaction
+    std::string_view encoded(size_t position) const {
+        const Entry& entry = entries[position];
+        return std::string_view(bytes.data() + entry.offset, entry.length);
+    }
+
+    // Zero-copy view of one transaction
+    BlockCodec::TransactionView operator[](size_t position) const {
+        BlockCodec::TransactionView view;
+        size_t pos = 0;
+        view.parse(encoded(position), pos);
+        return view;
+    }
+
+    // Cached digest of one transaction, and all of them in order (Merkle leaves)
+    const Hash256& digest(size_t position) const { return digests[position]; }
+    const std::vector<Hash256>& get_digests() const { return digests; }
+
+    // Digest of an encoded transaction (same value as Transaction::get_digest())
+    static Hash256 compute_digest(std::string_view encoded) {
+        return Hash256::digest(encoded);
+    }
+
+    // Iterates the arena as TransactionViews
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = BlockCodec::TransactionView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = BlockCodec::TransactionView;
+
+        const_iterator(const TransactionArena* arena, size_t position) : arena(arena), position(position) {}
+        BlockCodec::TransactionView operator*() const { return (*arena)[position]; }
+        const_iterator& operator++() { ++position; return *this; }
+        bool operator==(const const_iterator& other) const { return position == other.position; }
+        bool operator!=(const const_iterator& other) const { return position != other.position; }
+
+    private:
+        const TransactionArena* arena;
+        size_t position;
+    };
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, entries.size()); }
+
+private:
+    struct Entry {
+        uint32_t offset;   // Offset of the encoded transaction in bytes
+        uint32_t length;   // Encoded length
+    };
+
+    std::string bytes;                  // Encoded transactions, back to back
+    std::vector<Entry> entries;         // Where each transaction lives in bytes
+    std::vector<Hash256> digests;       // Cached transaction digests
+};
+
+#endif // TRANSACTION_ARENA_H